@@ -2,7 +2,7 @@
 #define MORE_GENS_COMMON_H
 
 typedef struct more_gens_ids_t {
-    const char *replicator;
+    tsc_id_t replicator;
 } more_gens_ids_t;
 
 extern more_gens_ids_t more_gens_ids;
@@ -2,8 +2,8 @@
 #define MORE_MOVERS_COMMON_H
 
 typedef struct more_movers_ids_t {
-    const char *puller;
-    const char *fan;
+    tsc_id_t puller;
+    tsc_id_t fan;
 } more_movers_ids_t;
 
 extern more_movers_ids_t more_movers_ids;
@@ -2,7 +2,8 @@
 #include "pushers.h"
 
 void moremovers_doFan(tsc_cell *cell, int x, int y, int ux, int uy, void *payload) {
-    int fx = tsc_grid_frontX(x, cell->rot);
-    int fy = tsc_grid_frontY(y, cell->rot);
-    tsc_grid_push(currentGrid, fx, fy, cell->rot, 1, NULL);
+    char rot = tsc_cell_getRotation(cell);
+    int fx = tsc_grid_frontX(x, rot);
+    int fy = tsc_grid_frontY(y, rot);
+    tsc_grid_push(currentGrid, fx, fy, rot, 1, NULL);
 }
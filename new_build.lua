@@ -280,6 +280,7 @@ end
 local libtsc = {
     "src/threads/workers.c",
     "src/utils.c",
+    "src/engine.c",
     "src/cells/cell.c",
     "src/cells/grid.c",
     "src/cells/ticking.c",
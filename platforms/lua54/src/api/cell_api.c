@@ -3,6 +3,7 @@
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
+#include <stdio.h>
 
 const char *lua54_tsc_cellptr_meta = "lua54_tsc_cellptr_meta";
 
@@ -17,22 +18,22 @@ int lua54_tsc_cellptr_index(lua_State *L) {
     if(key == NULL) return 0;
 
     if(tsc_streql(key, "id")) {
-        lua_pushstring(L, cell->id);
+        lua_pushstring(L, tsc_idToString(cell->id));
         return 1;
     }
     if(tsc_streql(key, "texture")) {
-        if(cell->texture == NULL) {
+        if(cell->texture == TSC_NULL_TEXTURE) {
             return 0;
         }
-        lua_pushstring(L, cell->texture);
+        lua_pushstring(L, tsc_idToString(cell->texture));
         return 1;
     }
     if(tsc_streql(key, "rot")) {
-        lua_pushinteger(L, cell->rot);
+        lua_pushinteger(L, tsc_cell_getRotation(cell));
         return 1;
     }
     if(tsc_streql(key, "addedRot")) {
-        lua_pushinteger(L, cell->addedRot);
+        lua_pushinteger(L, tsc_cell_getAddedRotation(cell));
         return 1;
     }
     if(tsc_streql(key, "lx")) {
@@ -62,14 +63,14 @@ int lua54_tsc_cellptr_newindex(lua_State *L) {
 
     if(tsc_streql(key, "texture")) {
         if(lua_isnoneornil(L, 3)) {
-            cell->texture = NULL;
+            cell->texture = TSC_NULL_TEXTURE;
             return 0;
         }
         const char *s = lua_tostring(L, 3);
         if(s == NULL) {
             luaL_error(L, "texture expected to be string");
         }
-        cell->texture = s;
+        cell->texture = tsc_findID(s);
     }
     if(tsc_streql(key, "lx")) {
         cell->lx = lua_tonumber(L, 3);
@@ -78,7 +79,7 @@ int lua54_tsc_cellptr_newindex(lua_State *L) {
         cell->ly = lua_tonumber(L, 3);
     }
     if(tsc_streql(key, "addedRot")) {
-        cell->addedRot = lua_tonumber(L, 3);
+        tsc_cell_setRotationData(cell, tsc_cell_getRotation(cell), lua_tonumber(L, 3));
     }
     luaL_getmetatable(L, lua54_tsc_cellptr_meta);
     lua_getfield(L, -1, key);
@@ -130,6 +131,56 @@ int lua54_tsc_binding_canMove(tsc_grid *grid, tsc_cell *cell, int x, int y, char
     return result;
 }
 
+// Calls the update function at f with a cell. Errors are ignored, like everywhere else.
+static void lua54_tsc_callUpdate(lua_State *L, int f, tsc_cell *cell, int x, int y, int ux, int uy) {
+    lua_pushvalue(L, f);
+    lua54_tsc_pushcellptr(L, cell);
+    lua_pushinteger(L, x);
+    lua_pushinteger(L, y);
+    lua_pushinteger(L, ux);
+    lua_pushinteger(L, uy);
+    lua_pcall(L, 5, 0, 0);
+    lua_settop(L, f);
+}
+
+void lua54_tsc_binding_update(tsc_cell *cell, int x, int y, int ux, int uy, lua54_CellPayload *payload) {
+    mtx_lock(&payload->vm->gil);
+    lua_State *L = payload->vm->state;
+    int otop = lua_gettop(L);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, payload->configRef);
+    lua_getfield(L, -1, "update");
+    int f = lua_gettop(L);
+    if(lua_isfunction(L, f)) {
+        lua54_tsc_callUpdate(L, f, cell, x, y, ux, uy);
+    }
+
+    lua_settop(L, otop); // prevent leaks
+
+    mtx_unlock(&payload->vm->gil);
+}
+
+// Same as update, but the lock and the config lookup only happen once for the whole batch
+void lua54_tsc_binding_updateBatch(tsc_cell_update_t *updates, size_t len, lua54_CellPayload *payload) {
+    mtx_lock(&payload->vm->gil);
+    lua_State *L = payload->vm->state;
+    int otop = lua_gettop(L);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, payload->configRef);
+    lua_getfield(L, -1, "update");
+    int f = lua_gettop(L);
+    if(lua_isfunction(L, f)) {
+        for(size_t i = 0; i < len; i++) {
+            tsc_cell_update_t *update = updates + i;
+            // Something earlier in the batch moved it away, replaced it or already updated it
+            if(!tsc_cell_startUpdate(update)) continue;
+            lua54_tsc_callUpdate(L, f, update->cell, update->x, update->y, update->ux, update->uy);
+        }
+    }
+
+    lua_settop(L, otop); // prevent leaks
+
+    mtx_unlock(&payload->vm->gil);
+}
+
 int lua54_tsc_addCell(lua_State *L) {
 	luaL_checktype(L, 1, LUA_TTABLE);
 	lua_pushvalue(L, 1); // push table
@@ -161,13 +212,14 @@ int lua54_tsc_addCell(lua_State *L) {
 	if(id == NULL) {
 		luaL_error(L, "TSC: invalid description for %s", id);
 	}
-	id = tsc_registerCell(id, name, description);
+	tsc_id_t cellID = tsc_registerCell(id, name, description);
+	id = tsc_idToString(cellID);
 	printf("[LUA] Adding a cell: %s\n", id);
     // This bullshit can cause memory leaks if an error occurs, but if one does, you're fucked anyways
-    tsc_cell tmp = tsc_cell_create(id, 0); // lite cell, needn't worry about deleting
-    tsc_celltable *table = tsc_cell_getTable(&tmp);
+    tsc_celltable *table = tsc_cell_newTable(cellID);
     lua54_CellPayload *payload = malloc(sizeof(lua54_CellPayload));
     payload->cellID = id;
+    table->payload = payload;
     lua_getfield(L, LUA_REGISTRYINDEX, lua54_magic_rkey);
     payload->vm = lua_touserdata(L, -1);
     lua_pop(L, 1);
@@ -184,6 +236,12 @@ int lua54_tsc_addCell(lua_State *L) {
         table->canMove = (void *)lua54_tsc_binding_canMove;
     }
     lua_pop(L, 1);
+    lua_getfield(L, -1, "update");
+    if(lua_isfunction(L, -1)) {
+        table->update = (void *)lua54_tsc_binding_update;
+        table->updateBatch = (void *)lua54_tsc_binding_updateBatch;
+    }
+    lua_pop(L, 1);
 
     // Return ID
 	lua_pushstring(L, id);
@@ -1,6 +1,6 @@
 // MIT License
 // 
-// Copyright 2024 Pârău Ionuț Alexandru
+// Copyright 2025 Pârău Ionuț Alexandru
 // 
 // Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the “Software”), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
 // 
@@ -13,8 +13,10 @@ extern "C" {
 #ifndef TSC_GRID_H
 #define TSC_GRID_H
 
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct tsc_cellreg {
     const char **keys;
@@ -22,23 +24,60 @@ typedef struct tsc_cellreg {
     size_t len;
 } tsc_cellreg;
 
+#define TSC_MAX_ID 65535
+#define TSC_ID_COUNT 65536
+typedef unsigned short tsc_id_t;
+typedef unsigned short tsc_last_t;
+typedef int tsc_reg_t;
+#define TSC_NULL_LAST 65535
+#define TSC_NULL_TEXTURE 0
+#define TSC_NULL_EFFECT 0
+#define TSC_NULL_REGISTRY 0
+
+// TODO: maybe do some optimizations BlobKat suggested
+// shrink texture to 1 byte, have texture IDs associated with cell IDs
+// make lx and ly 1 byte each, and relative to current position
+// make effect 1 byte too
+
 typedef struct tsc_cell {
-    const char *id;
-    const char *texture;
-    tsc_cellreg *data;
-    struct tsc_celltable *celltable;
-    size_t flags;
-    int lx;
-    int ly;
-    char rot;
-    signed char addedRot;
-    bool updated;
+#ifdef TSC_TURBO
+    unsigned char id : 6;
+    unsigned char rotData : 2;
+#else
+    tsc_id_t id;
+    tsc_id_t texture;
+    char rotData;
+    char updated;
+    tsc_id_t effect;
+    tsc_reg_t reg;
+    tsc_last_t lx;
+    tsc_last_t ly;
+#endif
 } tsc_cell;
 
+// The chunk size new grids get (existing ones keep theirs until resized).
+// Has to be a power of 2, anything else gets rounded up.
+#ifndef TSC_DEFAULT_CHUNK_SIZE
+#define TSC_DEFAULT_CHUNK_SIZE 32
+#endif
+extern size_t tsc_gridChunkSize;
 typedef struct tsc_grid tsc_grid;
 
 #define TSC_FLAGS_PLACEABLE 1
 
+// One cell which is getting updated, as handed to updateBatch
+typedef struct tsc_cell_update_t {
+    tsc_cell *cell;
+    // The ID it had when it got queued
+    tsc_id_t id;
+    // Whether it goes through updated (neighbour updates don't)
+    bool tracked;
+    int x;
+    int y;
+    int ux;
+    int uy;
+} tsc_cell_update_t;
+
 // Stores function pointers and payload for everything we might need from a modded cell.
 // Can be used in place of ID comparison (technically) but it's not much of a benefit.
 typedef struct tsc_celltable {
@@ -53,12 +92,36 @@ typedef struct tsc_celltable {
     void (*onTrash)(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force, tsc_cell *eating, void *payload);
     int (*isAcid)(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy, void *payload);
     void (*onAcid)(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy, void *payload);
+    // Optional, and used instead of update if set. Gets runs of cells from the same line of a subtick, in the order update would have been
+    // called on them. Earlier ones can move or replace later ones, so only update the ones tsc_cell_startUpdate says yes to.
+    void (*updateBatch)(tsc_cell_update_t *updates, size_t len, void *payload);
 } tsc_celltable;
 
-tsc_celltable *tsc_cell_newTable(const char *id);
+tsc_celltable *tsc_cell_newTable(tsc_id_t id);
 tsc_celltable *tsc_cell_getTable(tsc_cell *cell);
+// For updateBatch. False if the cell was already updated or isn't the one which got queued anymore, otherwise marks it updated.
+bool tsc_cell_startUpdate(tsc_cell_update_t *update);
 size_t tsc_cell_getTableFlags(tsc_cell *cell);
 
+// What every ID does without needing to ask its table, so hot paths can skip checking the callbacks one by one.
+// Worked out from the tables (and what the builtins do) before every tick, since mods fill in their tables whenever.
+// canMove is always true
+#define TSC_CAP_MOVABLE 1
+// getBias is always 0
+#define TSC_CAP_NO_BIAS 2
+// isTrash is always false
+#define TSC_CAP_NOT_TRASH 4
+// isAcid is always false
+#define TSC_CAP_NOT_ACID 8
+// canGenerate is always true
+#define TSC_CAP_CAN_GENERATE 16
+// None of the callbacks above are set, so what they return only depends on the ID, the rotation and the force
+#define TSC_CAP_NO_HOOKS 32
+// Pushes and pulls go right through these
+#define TSC_CAP_PLAIN (TSC_CAP_MOVABLE | TSC_CAP_NO_BIAS | TSC_CAP_NOT_TRASH | TSC_CAP_NOT_ACID)
+
+unsigned char tsc_cell_getCapabilities(tsc_id_t id);
+
 typedef struct tsc_texture_id_pool_t {
     const char *icon;
     const char *copy;
@@ -66,6 +129,9 @@ typedef struct tsc_texture_id_pool_t {
     const char *del;
     const char *setinitial;
     const char *restoreinitial;
+    const char *fill;
+    const char *flip_h;
+    const char *flip_v;
 } tsc_texture_id_pool_t;
 
 typedef struct tsc_audio_id_pool_t {
@@ -78,6 +144,18 @@ typedef struct tsc_optimization_id_pool_t {
     size_t gens[4];
 } tsc_optimization_id_pool_t;
 
+// Force types are registered once and passed around as small integers, so the interaction functions compare numbers instead of strings.
+// Cell tables still get the name, which is interned.
+typedef size_t tsc_force_t;
+#define TSC_MAX_FORCE_TYPES 256
+// What names which were never registered turn into
+#define TSC_UNKNOWN_FORCE TSC_MAX_FORCE_TYPES
+
+typedef struct tsc_force_id_pool_t {
+    tsc_force_t push;
+    tsc_force_t pull;
+} tsc_force_id_pool_t;
+
 typedef struct tsc_setting_id_pool_t {
     const char *vsync;
     const char *fullscreen;
@@ -88,37 +166,51 @@ typedef struct tsc_setting_id_pool_t {
     const char *unfocusedVolume;
     const char *updateDelay;
     const char *mtpf;
+    const char *v3speed;
+    const char *fancyRendering;
+    const char *debugMode;
+    const char *v3cache;
 } tsc_setting_id_pool_t;
 
 typedef struct tsc_id_pool_t {
-    const char *empty;
-    const char *placeable;
-    const char *mover;
-    const char *generator;
-    const char *push;
-    const char *slide;
-    const char *rotator_cw;
-    const char *rotator_ccw;
-    const char *enemy;
-    const char *trash;
-    const char *wall;
+    tsc_id_t empty;
+    tsc_id_t placeable;
+    tsc_id_t mover;
+    tsc_id_t generator;
+    tsc_id_t push;
+    tsc_id_t slide;
+    tsc_id_t rotator_cw;
+    tsc_id_t rotator_ccw;
+    tsc_id_t enemy;
+    tsc_id_t trash;
+    tsc_id_t wall;
     tsc_texture_id_pool_t textures;
     tsc_audio_id_pool_t audio;
     tsc_optimization_id_pool_t optimizations;
     tsc_setting_id_pool_t settings;
+    tsc_force_id_pool_t forces;
 } tsc_cell_id_pool_t;
 
 extern tsc_cell_id_pool_t builtin;
 
 
-tsc_cell tsc_cell_create(const char *id, char rot);
+tsc_cell tsc_cell_create(tsc_id_t id, char rot);
 tsc_cell tsc_cell_clone(tsc_cell *cell);
 void tsc_cell_swap(tsc_cell *a, tsc_cell *b);
 void tsc_cell_destroy(tsc_cell cell);
-const char *tsc_cell_get(const tsc_cell *cell, const char *key);
-const char *tsc_cell_nthKey(const tsc_cell *cell, size_t idx);
-void tsc_cell_set(tsc_cell *cell, const char *key, const char *value);
 void tsc_cell_rotate(tsc_cell *cell, signed char amount);
+char tsc_cell_getRotation(tsc_cell *cell);
+void tsc_cell_setRotationData(tsc_cell *cell, signed char rot, signed char addedRot);
+signed char tsc_cell_getAddedRotation(tsc_cell *cell);
+
+// A set of positions, stored as a bitset once row-major and once column-major (each row or column padded to 64 bits),
+// along with how many positions are in each row and column.
+typedef struct tsc_grid_index {
+    atomic_ullong *rows;
+    atomic_ullong *columns;
+    atomic_int *rowCounts;
+    atomic_int *columnCounts;
+} tsc_grid_index;
 
 typedef struct tsc_grid {
     tsc_cell *cells;
@@ -128,10 +220,35 @@ typedef struct tsc_grid {
     const char *title;
     const char *desc;
     size_t refc;
-    bool *chunkdata;
+    // One bit per chunk, each row of chunks is padded to chunkwords words.
+    atomic_ullong *chunkdata;
     int chunkwidth;
     int chunkheight;
     char *optData;
+    tsc_grid_index *indices;
+    size_t indexc;
+    size_t indexGeneration;
+    // The ID of every cell, kept in sync along with the indices. Scans which only care about IDs should use this
+    // instead of dragging entire cells through the cache. Only valid while ticking.
+    tsc_id_t *idPlane;
+    // Positions changed this tick, see tsc_grid_markDirty
+    atomic_ullong *dirty;
+    atomic_bool *dirtyRows;
+    // The dirty positions whose cell actually changed, not just updated or got optimized
+    atomic_ullong *changed;
+    // The last tick something changed in every chunk-wide piece of every row, and every chunk-tall piece of every column
+    atomic_uint *rowStamps;
+    atomic_uint *columnStamps;
+    // Goes up by 1 every tick
+    unsigned int epoch;
+    // See tsc_grid_setBlocked
+    uint64_t *blocked;
+    size_t chunkwords;
+    // Chunks are 1 << chunkshift cells wide
+    int chunkshift;
+    // How many chunks are enabled in every row and column of chunks
+    atomic_int *chunkRowCounts;
+    atomic_int *chunkColumnCounts;
 } tsc_grid;
 
 typedef struct tsc_gridStorage {
@@ -143,6 +260,24 @@ typedef struct tsc_gridStorage {
 extern tsc_grid *currentGrid;
 extern int tsc_maxSliceSize;
 
+// At most this many trashed cells are kept per thread, and in total per tick
+#define TSC_MAX_TRASHED 131072
+
+typedef struct tsc_trashed_cell_t {
+    tsc_cell cell;
+    int x;
+    int y;
+} tsc_trashed_cell_t;
+
+void tsc_trashCell(tsc_cell *cell, int x, int y);
+// The cells trashed during the last finished tick, for drawing them fading out.
+// The array stays valid until tsc_releaseTrashedCells, however many ticks finish in between. Only one thread may read them at a time.
+tsc_trashed_cell_t *tsc_getTrashedCells(size_t *len);
+void tsc_releaseTrashedCells();
+// Only call these while nothing is ticking
+void tsc_clearTrashedCells();
+
+
 tsc_grid *tsc_getGrid(const char *name);
 tsc_grid *tsc_createGrid(const char *id, int width, int height, const char *title, const char *description);
 void tsc_retainGrid(tsc_grid *grid);
@@ -151,6 +286,9 @@ void tsc_switchGrid(tsc_grid *grid);
 void tsc_copyGrid(tsc_grid *dest, tsc_grid *src);
 void tsc_clearGrid(tsc_grid *grid, int width, int height);
 void tsc_nukeGrids();
+// Returns how many positions have a different cell or background, and puts the first one (left to right, top to bottom) in x and y.
+// Grids of different sizes are different everywhere.
+size_t tsc_diffGrids(tsc_grid *a, tsc_grid *b, int *x, int *y);
 
 size_t tsc_allocOptimization(const char *id);
 size_t tsc_findOptimization(const char *trueID);
@@ -173,10 +311,58 @@ void tsc_grid_disableChunk(tsc_grid *grid, int x, int y);
 bool tsc_grid_checkChunk(tsc_grid *grid, int x, int y);
 bool tsc_grid_checkRow(tsc_grid *grid, int y);
 bool tsc_grid_checkColumn(tsc_grid *grid, int x);
+// Disables every chunk that has no cells or backgrounds in it anymore. The tick loop does this before every tick.
+void tsc_grid_sweepChunks(tsc_grid *grid);
+// Start of the chunk off chunks away from the one x is in
+int tsc_grid_chunkOff(tsc_grid *grid, int x, int off);
 bool tsc_grid_checkOptimization(tsc_grid *grid, int x, int y, size_t optimization);
 void tsc_grid_setOptimization(tsc_grid *grid, int x, int y, size_t optimization, bool enabled);
 
+// Sparse position indices, so subticks only visit the cells they care about instead of the entire grid.
+// Index N holds every position whose cell ID was added to it. They are kept up to date by tsc_grid_set, tsc_grid_push
+// and tsc_cell_swap (for the current grid), and are rebuilt (along with idPlane) by tsc_grid_syncIndices when the grid was replaced wholesale
+// (loading, resizing, switching) or new IDs were indexed. Anything writing to cells directly must call tsc_grid_invalidateIndices.
+#define TSC_MAX_INDICES 64
+#define TSC_NO_INDEX TSC_MAX_INDICES
+
+// Returns TSC_NO_INDEX if we ran out
+size_t tsc_grid_newIndex();
+void tsc_grid_addIndexedID(size_t index, tsc_id_t id);
+void tsc_grid_invalidateIndices(tsc_grid *grid);
+void tsc_grid_syncIndices(tsc_grid *grid);
+// The rest assume the indices are in sync
+bool tsc_grid_checkIndexedRow(tsc_grid *grid, size_t index, int y);
+bool tsc_grid_checkIndexedColumn(tsc_grid *grid, size_t index, int x);
+// How many indexed positions are in the row or column
+int tsc_grid_countIndexedRow(tsc_grid *grid, size_t index, int y);
+int tsc_grid_countIndexedColumn(tsc_grid *grid, size_t index, int x);
+// Closest indexed position at or after (next) / at or before (prev) the given one in the row or column. -1 if there is none.
+int tsc_grid_nextIndexedInRow(tsc_grid *grid, size_t index, int x, int y);
+int tsc_grid_prevIndexedInRow(tsc_grid *grid, size_t index, int x, int y);
+int tsc_grid_nextIndexedInColumn(tsc_grid *grid, size_t index, int x, int y);
+int tsc_grid_prevIndexedInColumn(tsc_grid *grid, size_t index, int x, int y);
+// Instead of resetting every cell before every tick, only positions which changed are reset.
+// Setting, pushing, swapping, rotating, optimizations and updates by subticks do this for you, but if you change updated, lx, ly
+// or rotData through a pointer yourself, mark it dirty, or else it'll stay that way next tick.
+void tsc_grid_markDirty(tsc_grid *grid, int x, int y);
+// Clears updated, resets lx/ly and added rotation and zeroes the optimizations of every dirty position. Done before every tick.
+void tsc_grid_resetDirty(tsc_grid *grid);
+// Cells which keep failing at the same thing can remember it, instead of trying again every tick.
+// This says the cell at x, y failed in dir, and that it only depends on the len cells starting right behind it going in dir.
+// It stays blocked until one of those changes (or anything near them, in the same chunk-sized piece of the line).
+// Only use it if the result depends on nothing but those cells, so no callbacks which could look at anything else.
+void tsc_grid_setBlocked(tsc_grid *grid, int x, int y, char dir, int len);
+bool tsc_grid_isBlocked(tsc_grid *grid, int x, int y, char dir);
+
+// Registering the same name twice gives the same ID. Returns TSC_UNKNOWN_FORCE if there are too many.
+tsc_force_t tsc_registerForceType(const char *name);
+// TSC_UNKNOWN_FORCE if it was never registered
+tsc_force_t tsc_findForceType(const char *name);
+// NULL for TSC_UNKNOWN_FORCE
+const char *tsc_forceTypeName(tsc_force_t forceType);
+
 // Cell interactions
+// The ones taking a string are for compatibility, they look up the force type every time.
 
 int tsc_cell_canMove(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force);
 float tsc_cell_getBias(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force);
@@ -185,10 +371,22 @@ int tsc_cell_isTrash(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, con
 void tsc_cell_onTrash(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force, tsc_cell *eating);
 int tsc_cell_isAcid(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy);
 void tsc_cell_onAcid(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy);
+int tsc_cell_canMoveWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force);
+float tsc_cell_getBiasWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force);
+int tsc_cell_isTrashWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force, tsc_cell *eating);
+void tsc_cell_onTrashWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force, tsc_cell *eating);
+int tsc_cell_isAcidWith(tsc_grid *grid, tsc_cell *cell, char dir, tsc_force_t forceType, double force, tsc_cell *dissolving, int dx, int dy);
+void tsc_cell_onAcidWith(tsc_grid *grid, tsc_cell *cell, char dir, tsc_force_t forceType, double force, tsc_cell *dissolving, int dx, int dy);
 char *tsc_cell_signal(tsc_cell *cell, int x, int y, const char *protocol, const char *data, tsc_cell *sender, int sx, int sy);
 
+// Parallel subticks give every task a line (a row or a column), and whatever a cell does while it's updated should stay on that line,
+// since other threads are busy with the ones around it. Pushes, pulls and writes which leave it are counted as conflicts,
+// and a subtick which had any goes back to running serially, see tsc_subtick_t.
+
 // Returns how many cells were pushed.
+// If it failed, tsc_grid_failedPushLength says how many cells it looked at, including the one that stopped it.
 int tsc_grid_push(tsc_grid *grid, int x, int y, char dir, double force, tsc_cell *replacement);
+int tsc_grid_failedPushLength();
 // Returns how many cells were pulled.
 int tsc_grid_pull(tsc_grid *grid, int x, int y, char dir, double force, tsc_cell *replacement);
 // Returns how many cells were grabbed.
@@ -202,12 +400,16 @@ bool tsc_grid_nudge(tsc_grid *grid, int x, int y, char dir, tsc_cell *replacemen
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #define TSC_SUBMODE_TICKED 0
 #define TSC_SUBMODE_TRACKED 1
 #define TSC_SUBMODE_NEIGHBOUR 2
 #define TSC_SUBMODE_CUSTOM 3
 
+// A custom subtick is a list of passes. order is the direction of the pass, the same way tracked subticks go
+// (0 is right, which scans rows from right to left so the cells in front go first, 1 is down, 2 is left and 3 is up),
+// and rots are which rotations get updated during it. Tracked subticks are {0, [0]}, {2, [2]}, {3, [3]}, {1, [1]}.
 typedef struct tsc_subtick_custom_order {
     int order;
     int rotc;
@@ -215,8 +417,10 @@ typedef struct tsc_subtick_custom_order {
 } tsc_subtick_custom_order;
 
 typedef struct tsc_subtick_t {
-    const char **ids;
+    tsc_id_t *ids;
     size_t idc;
+    // Position index of the cells in ids, or TSC_NO_INDEX if we ran out.
+    size_t cellIndex;
     const char *name;
     union {
         tsc_subtick_custom_order **customOrder;
@@ -225,12 +429,27 @@ typedef struct tsc_subtick_t {
     char mode;
     char parallel;
     char spacing;
+    // Names of the subticks this one commutes with, see tsc_subtick_commute
+    const char **commutes;
+    size_t commutec;
+    // How many pushes, pulls and writes left their line this tick while running in parallel, see tsc_grid_claimLine.
+    // If this isn't 0, this tick might have gone differently with another thread count. The subtick stops being parallel
+    // right after, so only the first tick it happens on can be off.
+    size_t conflicts;
+    // Bit per ID, set for the ones in ids. Built by tsc_subtick_add and kept up to date by tsc_subtick_addCell.
+    uint64_t *idBits;
 } tsc_subtick_t;
 
 typedef struct tsc_updateinfo_t {
     tsc_subtick_t *subtick;
     int x;
+    // Tracked subticks get a strip of every (spacing + 1)th line from x up to (but excluding) end
+    int end;
+    // Custom subticks do the orders from order up to (but excluding) orderEnd on every line
+    int order;
+    int orderEnd;
     char rot;
+    size_t conflicts;
 } tsc_updateinfo_t;
 
 typedef struct tsc_subtick_manager_t {
@@ -241,14 +460,47 @@ typedef struct tsc_subtick_manager_t {
 extern tsc_subtick_manager_t subticks;
 
 tsc_subtick_t *tsc_subtick_add(tsc_subtick_t subtick);
-void tsc_subtick_addCell(tsc_subtick_t *subtick, const char *id);
+void tsc_subtick_addCell(tsc_subtick_t *subtick, tsc_id_t id);
 tsc_subtick_t *tsc_subtick_find(const char *name);
 tsc_subtick_t *tsc_subtick_addTicked(const char *name, double priority, char spacing, bool parallel);
 tsc_subtick_t *tsc_subtick_addTracked(const char *name, double priority, char spacing, bool parallel);
 tsc_subtick_t *tsc_subtick_addNeighbour(const char *name, double priority, char spacing, bool parallel);
 tsc_subtick_t *tsc_subtick_addCustom(const char *name, double priority, char spacing, bool parallel, tsc_subtick_custom_order *orders, size_t orderc);
+// Declares that a and b can run at the same time, in any order, because they never touch the same cells (or it doesn't matter if they do).
+// Subticks next to each other (by priority) which all commute with each other run concurrently as one stage.
+void tsc_subtick_commute(tsc_subtick_t *a, tsc_subtick_t *b);
+// Time spent in each part of a tick, in seconds. Times are added, not set, so it can accumulate across ticks.
+// subtickTimes is indexed like subticks.subs and must have room for subc entries.
+typedef struct tsc_subtick_profile_t {
+    double reset;
+    double *subtickTimes;
+    size_t subc;
+} tsc_subtick_profile_t;
+
 void tsc_subtick_addCore();
 void tsc_subtick_run();
+void tsc_subtick_runProfiled(tsc_subtick_profile_t *profile);
+
+// Where a verified tick first went differently
+typedef struct tsc_subtick_divergence_t {
+    // The subtick after which the grids were different. If it ran as part of a stage, this is the first one in the stage.
+    const char *subtick;
+    // The first different position, left to right, top to bottom
+    int x;
+    int y;
+    // How many positions were different
+    size_t cells;
+    // The conflicts the stage's subticks had on that tick. If it's 0, something raced without leaving its line.
+    size_t conflicts;
+} tsc_subtick_divergence_t;
+
+// Runs a tick on the current grid with the workers, and the same tick on a copy through the serial loops, one stage at a time.
+// After every stage the two are compared. Returns false and fills in divergence if they ever differ.
+// The current grid keeps the result from the workers. It's a lot slower than a normal tick, so it's only for
+// catching parallel subticks which don't do the same as the serial ones.
+bool tsc_subtick_runVerified(tsc_subtick_divergence_t *divergence);
+// Same, but the profile only gets the time spent on the current grid, not on the copy
+bool tsc_subtick_runVerifiedProfiled(tsc_subtick_divergence_t *divergence, tsc_subtick_profile_t *profile);
 
 #endif
 #ifndef TSC_SAVING_H
@@ -268,19 +520,25 @@ typedef tsc_buffer tsc_saving_buffer;
 tsc_buffer tsc_saving_newBuffer(const char *initial);
 tsc_buffer tsc_saving_newBufferCapacity(const char *initial, size_t capacity);
 void tsc_saving_deleteBuffer(tsc_buffer buffer);
+char *tsc_saving_reserveFor(tsc_buffer *buffer, size_t amount);
 void tsc_saving_write(tsc_buffer *buffer, char ch);
 void tsc_saving_writeStr(tsc_buffer *buffer, const char *str);
 void __attribute__((format (printf, 2, 3))) tsc_saving_writeFormat(tsc_buffer *buffer, const char *fmt, ...);
 void tsc_saving_writeBytes(tsc_buffer *buffer, const char *mem, size_t count);
+void tsc_saving_clearBuffer(tsc_buffer *buffer);
 
 typedef int tsc_saving_encoder(tsc_buffer *buffer, tsc_grid *grid);
 typedef void tsc_saving_decoder(const char *code, tsc_grid *grid);
 
+#define TSC_SAVING_COMPATIBILITY 1
+
+
 typedef struct tsc_saving_format {
     const char *name;
     const char *header;
     tsc_saving_encoder *encode;
     tsc_saving_decoder *decode;
+    size_t flags;
 } tsc_saving_format;
 
 int tsc_saving_encodeWith(tsc_buffer *buffer, tsc_grid *grid, const char *name);
@@ -292,6 +550,8 @@ void tsc_saving_decodeWithAny(const char *code, tsc_grid *grid);
 void tsc_saving_register(tsc_saving_format format);
 void tsc_saving_registerCore();
 
+char *tsc_saving_safeFast(tsc_grid *grid);
+
 #endif
 #ifndef TSC_RESOURCES_H
 #define TSC_RESOURCES_H
@@ -501,13 +761,12 @@ bool workers_isDisabled();
     #define TSC_POSIX
 #endif
 
-// x64 gives us 64 bit pointers, but in virtual memory, they become 48-bit pointers.
-// 12 bits for a 4kb index within a page, 4 indexes 9 bits each which tell the CPU how to traverse the page table.
-// The remaining 16 bits must be empty in case the 5th index is ever implemented, but it can be used to store extra info.
-#if defined(__x86_64) || defined(_M_X64)
-    #define TSC_PTR_HAS_SHORT 1
+#if defined(__clang__) || defined(__GNUC__)
+    #define TSC_LIKELY(x) __builtin_expect(!!(x), 1)
+    #define TSC_UNLIKELY(x) __builtin_expect(!!(x), 0)
 #else
-    #define TSC_PTR_HAS_SHORT 0
+    #define TSC_LIKELY(x) (x)
+    #define TSC_UNLIKELY(x) (x)
 #endif
 
 const char *tsc_strintern(const char *str);
@@ -541,14 +800,15 @@ void tsc_free(void *buffer);
 bool tsc_getBit(char *num, size_t bit);
 void tsc_setBit(char *num, size_t bit, bool value);
 
-unsigned char tsc_getUnusedPointerByte(void *pointer);
-void *tsc_getPointerWithoutByte(void *pointer);
-void *tsc_setUnusedPointerByte(void *pointer, unsigned char byte);
-// x64 only
-unsigned short tsc_getUnusedPointerShort(void *pointer);
-void *tsc_getPointerWithoutShort(void *pointer);
-// x64 only
-void *tsc_setUnusedPointerShort(void *pointer, unsigned short byte);
+double tsc_mapNumber(double x, double min1, double max1, double min2, double max2);
+
+bool tsc_isLittleEndian();
+
+char **tsc_alloclines(const char *text, size_t *len);
+void tsc_freelines(char **lines);
+
+// Returns in seconds
+double tsc_clock();
 
 #ifndef TSC_POSIX
 
@@ -556,6 +816,24 @@ int asprintf(char **s, const char *fmt, ...);
 
 #endif
 
+
+typedef struct tsc_arena_t
+tsc_arena_t;
+
+extern tsc_arena_t tsc_tmp;
+
+tsc_arena_t tsc_aempty();
+void *tsc_aallocAligned(tsc_arena_t *arena, size_t size, size_t align);
+void *tsc_aalloc(tsc_arena_t *arena, size_t size);
+const char *tsc_asprintf(tsc_arena_t *arena, const char *fmt, ...);
+const char *tsc_tsprintf(const char *fmt, ...);
+void tsc_areset(tsc_arena_t *arena);
+void tsc_aclear(tsc_arena_t *arena);
+size_t tsc_acount(tsc_arena_t *arena);
+size_t tsc_aused(tsc_arena_t *arena);
+void *tsc_tallocAligned(size_t size, size_t align);
+void *tsc_talloc(size_t size);
+
 #endif
 #ifndef TSC_VALUE_H
 #define TSC_VALUE_H
@@ -723,9 +1001,13 @@ typedef struct tsc_cellprofile_t {
     const char *desc;
 } tsc_cellprofile_t;
 
-const char *tsc_registerCell(const char *id, const char *name, const char *description);
+tsc_id_t tsc_registerCell(const char *id, const char *name, const char *description);
+size_t tsc_countCells();
+void tsc_fillCells(tsc_id_t *buf);
+const char *tsc_idToString(tsc_id_t id);
+tsc_id_t tsc_findID(const char *id);
 
-tsc_cellprofile_t *tsc_getProfile(const char *id);
+tsc_cellprofile_t *tsc_getProfile(tsc_id_t id);
 
 typedef struct tsc_cellbutton {
     void *payload;
@@ -772,13 +1054,14 @@ tsc_category *tsc_rootCategory();
 tsc_category *tsc_newCategory(const char *title, const char *description, const char *icon);
 tsc_category *tsc_newCellGroup(const char *title, const char *description, const char *mainCell);
 void tsc_addCategory(tsc_category *category, tsc_category *toAdd);
-void tsc_addCell(tsc_category *category, const char *cell);
+void tsc_addCell(tsc_category *category, tsc_id_t cell);
 void tsc_addButton(tsc_category *category, const char *icon, const char *name, const char *description, void (*click)(void *), void *payload);
 tsc_category *tsc_getCategory(tsc_category *category, const char *path);
 
 
 tsc_value tsc_getSetting(const char *settingID);
 void tsc_setSetting(const char *settingID, tsc_value v);
+bool tsc_hasSetting(const char *settingID);
 const char *tsc_addSettingCategory(const char *settingCategoryID, const char *settingTitle);
 const char *tsc_addSetting(const char *settingID, const char *name, const char *categoryID, unsigned char kind, void *data, tsc_settingCallback *callback);
 
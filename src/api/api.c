@@ -6,12 +6,14 @@
 #include "../threads/workers.h"
 #include "../cells/grid.h"
 #include "../utils.h"
-#include <raylib.h>
 #include "../saving/saving.h"
-#include "../graphics/resources.h"
+#include "../engine.h"
 #include "../cells/ticking.h"
-#include "../graphics/rendering.h"
 #include "tscjson.h"
+#ifndef TSC_HEADLESS
+#include <raylib.h>
+#include "../graphics/rendering.h"
+#endif
 
 typedef struct tsc_splash_t {
     const char *splash;
@@ -288,7 +290,7 @@ void tsc_closeCategory(tsc_category *category) {
     }
 }
 
-
+#ifndef TSC_HEADLESS
 static void tsc_loadButton(void *_) {
     if(isGameTicking) return;
     const char *clipboard = GetClipboardText();
@@ -362,7 +364,7 @@ static void tsc_restoreInitial(void *_) {
     tsc_saving_decodeWithAny((const char *)initialCode, currentGrid);
     isInitial = true;
     tickCount = 0;
-    tsc_trashedCellCount = 0;
+    tsc_clearTrashedCells();
 }
 
 static void tsc_setInitial(void *_) {
@@ -377,10 +379,12 @@ static void tsc_setInitial(void *_) {
 static void tsc_pasteButton(void *_) {
     tsc_pasteGridClipboard();
 }
+#endif
 
 void tsc_loadDefaultCellBar() {
     tsc_category *root = tsc_rootCategory();
 
+#ifndef TSC_HEADLESS
     tsc_category *tools = tsc_newCategory("Tools", "Simple tools and buttons", "icon");
     tsc_addButton(tools, "save", "Save to Clipboard", "Save the current grid to clipboard using the most optimal encoding", tsc_saveButton, NULL);
     tsc_addButton(tools, "save_v3", "Save to V3", "Save the current grid using V3 encoding, which is compatible with lots of remakes (might fail)", tsc_saveV3Button, NULL);
@@ -391,6 +395,7 @@ void tsc_loadDefaultCellBar() {
     tsc_addButton(tools, "paste_clipboard", "Paste from Clipboard", "Paste a structure from clipboard", tsc_pasteClipboardButton, NULL);
 
     tsc_addCategory(root, tools);
+#endif
     tsc_category *movers = tsc_newCellGroup("Movers", "Cells that move by themselves and may also move other cells", tsc_idToString(builtin.mover));
     tsc_addCell(movers, builtin.mover);
     tsc_addCategory(root, movers);
@@ -420,6 +425,7 @@ size_t tsc_settingLen = 0;
 tsc_value tsc_settingStore;
 
 void tsc_settingHandler(const char *title) {
+#ifndef TSC_HEADLESS
     if(title == builtin.settings.vsync) {
         if(tsc_toBoolean(tsc_getSetting(builtin.settings.vsync))) {
             SetTargetFPS(GetMonitorRefreshRate(GetCurrentMonitor()));
@@ -433,7 +439,9 @@ void tsc_settingHandler(const char *title) {
             // TODO: fix this buggy as shit raylib goofy ah glitchyness
             // ToggleFullscreen();
         }
-    } else if(title == builtin.settings.updateDelay) {
+    }
+#endif
+    if(title == builtin.settings.updateDelay) {
         tickDelay = tsc_toNumber(tsc_getSetting(builtin.settings.updateDelay));
     } else if(title == builtin.settings.mtpf) {
         multiTickPerFrame = tsc_toBoolean(tsc_getSetting(builtin.settings.mtpf));
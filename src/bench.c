@@ -0,0 +1,382 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cells/grid.h"
+#include "cells/subticks.h"
+#include "cells/ticking.h"
+#include "saving/saving.h"
+#include "threads/workers.h"
+#include "api/value.h"
+#include "api/tscjson.h"
+#include "utils.h"
+#include "api/api.h"
+
+// tsc-bench, the benchmark menu but for machines.
+// Runs the levels in data/benches.txt (or a subset) and reports tick timings as JSON or CSV.
+
+typedef struct tsc_bench_result {
+    const char *name;
+    int width;
+    int height;
+    int threads;
+    int chunkSize;
+    double loadTime;
+    size_t ticks;
+    double totalTime;
+    double meanTick;
+    double medianTick;
+    double p99Tick;
+    double minTick;
+    double maxTick;
+    double tps;
+    double resetTime;
+    double *subtickTimes;
+    // Added up over the measured ticks, see tsc_subtick_t
+    size_t conflicts;
+    // Only filled in with --verify
+    bool diverged;
+    size_t divergedTick;
+    tsc_subtick_divergence_t divergence;
+} tsc_bench_result;
+
+static void tsc_bench_usage(const char *exe) {
+    fprintf(stderr, "Usage: %s [options]\n", exe);
+    fprintf(stderr, "\t--benches=<file> - The benchmark list, one name;level per line (default data/benches.txt)\n");
+    fprintf(stderr, "\t--filter=<a,b,...> - Only run benchmarks whose name contains one of these\n");
+    fprintf(stderr, "\t--ticks=N - Ticks to run per benchmark (default 100)\n");
+    fprintf(stderr, "\t--duration=S - Run each benchmark for S seconds instead of a fixed tick count\n");
+    fprintf(stderr, "\t--warmup=N - Ticks to run before measuring (default 0)\n");
+    fprintf(stderr, "\t--threads=N - Worker thread count, same rules as the Thread Count setting\n");
+    fprintf(stderr, "\t--chunkSize=N - Chunk size of the grids, rounded up to a power of 2 (default %d)\n", TSC_DEFAULT_CHUNK_SIZE);
+    fprintf(stderr, "\t--format=<json|csv> - Output format (default json)\n");
+    fprintf(stderr, "\t--output=<file> - Where to write the results (default stdout)\n");
+    fprintf(stderr, "\t--verify - Check every tick against a serial run. Tick timings include both runs, subtick timings don't.\n");
+    fprintf(stderr, "\t--list - Print the benchmark names and exit\n");
+}
+
+static bool tsc_bench_matches(const char *name, const char *filter) {
+    if(filter == NULL) return true;
+    const char *part = filter;
+    while(*part != '\0') {
+        const char *end = strchr(part, ',');
+        size_t len = end == NULL ? strlen(part) : (size_t)(end - part);
+        if(len > 0) {
+            for(const char *s = name; *s != '\0'; s++) {
+                if(strncmp(s, part, len) == 0) return true;
+            }
+        }
+        if(end == NULL) break;
+        part = end + 1;
+    }
+    return false;
+}
+
+static int tsc_bench_compareTimes(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    if(x < y) return -1;
+    if(x > y) return 1;
+    return 0;
+}
+
+// tick counts from the start of the warmup
+static void tsc_bench_tick(tsc_bench_result *result, size_t tick, tsc_subtick_profile_t *profile, bool verify) {
+    if(!verify) {
+        tsc_subtick_runProfiled(profile);
+        return;
+    }
+    if(tsc_subtick_runVerifiedProfiled(&result->divergence, profile)) return;
+    result->diverged = true;
+    result->divergedTick = tick;
+}
+
+static tsc_bench_result tsc_bench_run(const char *name, const char *level, size_t ticks, double duration, size_t warmup, bool verify) {
+    tsc_bench_result result = {0};
+    result.name = name;
+
+    tsc_nukeGrids();
+    tsc_grid *grid = tsc_createGrid("main", 100, 100, NULL, NULL);
+    double loadStart = tsc_clock();
+    tsc_saving_decodeWithAny(level, grid);
+    result.loadTime = tsc_clock() - loadStart;
+    tsc_switchGrid(grid);
+
+    result.width = grid->width;
+    result.height = grid->height;
+    result.threads = workers_amount();
+    result.chunkSize = 1 << grid->chunkshift;
+
+    for(size_t i = 0; i < warmup && !result.diverged; i++) {
+        tsc_bench_tick(&result, i, NULL, verify);
+    }
+
+    size_t cap = duration > 0 ? 1024 : ticks;
+    double *times = malloc(sizeof(double) * (cap == 0 ? 1 : cap));
+    result.subtickTimes = calloc(subticks.subc == 0 ? 1 : subticks.subc, sizeof(double));
+    tsc_subtick_profile_t profile = {0, result.subtickTimes, subticks.subc};
+
+    double start = tsc_clock();
+    size_t n = 0;
+    while(true) {
+        if(duration > 0) {
+            if(tsc_clock() - start >= duration) break;
+        } else if(n >= ticks) {
+            break;
+        }
+        if(n == cap) {
+            cap *= 2;
+            times = realloc(times, sizeof(double) * cap);
+        }
+        if(result.diverged) break;
+        double before = tsc_clock();
+        tsc_bench_tick(&result, warmup + n, &profile, verify);
+        times[n++] = tsc_clock() - before;
+        tickCount++;
+        for(size_t i = 0; i < subticks.subc; i++) {
+            result.conflicts += subticks.subs[i].conflicts;
+        }
+    }
+    result.totalTime = tsc_clock() - start;
+    result.ticks = n;
+
+    if(n > 0) {
+        double sum = 0;
+        for(size_t i = 0; i < n; i++) sum += times[i];
+        qsort(times, n, sizeof(double), tsc_bench_compareTimes);
+        result.meanTick = sum / n;
+        result.medianTick = n % 2 == 0 ? (times[n/2-1] + times[n/2]) / 2 : times[n/2];
+        // nearest-rank
+        size_t p99 = (n * 99 + 99) / 100;
+        result.p99Tick = times[p99 - 1];
+        result.minTick = times[0];
+        result.maxTick = times[n-1];
+        result.tps = result.totalTime > 0 ? n / result.totalTime : 0;
+        result.resetTime = profile.reset / n;
+        for(size_t i = 0; i < subticks.subc; i++) {
+            result.subtickTimes[i] /= n;
+        }
+    }
+
+    free(times);
+    return result;
+}
+
+// Everything is reported in milliseconds, except for TPS and load time
+static void tsc_bench_writeJSON(tsc_buffer *out, tsc_bench_result *results, size_t resultc, bool verify) {
+    tsc_value list = tsc_array(0);
+    for(size_t i = 0; i < resultc; i++) {
+        tsc_bench_result *r = results + i;
+        tsc_value obj = tsc_object();
+        tsc_setKey(obj, "name", tsc_cstring(r->name));
+        tsc_setKey(obj, "width", tsc_int(r->width));
+        tsc_setKey(obj, "height", tsc_int(r->height));
+        tsc_setKey(obj, "threads", tsc_int(r->threads));
+        tsc_setKey(obj, "chunkSize", tsc_int(r->chunkSize));
+        tsc_setKey(obj, "loadSeconds", tsc_number(r->loadTime));
+        tsc_setKey(obj, "ticks", tsc_int(r->ticks));
+        tsc_setKey(obj, "totalSeconds", tsc_number(r->totalTime));
+        tsc_setKey(obj, "tps", tsc_number(r->tps));
+        tsc_setKey(obj, "meanTickMs", tsc_number(r->meanTick * 1000));
+        tsc_setKey(obj, "medianTickMs", tsc_number(r->medianTick * 1000));
+        tsc_setKey(obj, "p99TickMs", tsc_number(r->p99Tick * 1000));
+        tsc_setKey(obj, "minTickMs", tsc_number(r->minTick * 1000));
+        tsc_setKey(obj, "maxTickMs", tsc_number(r->maxTick * 1000));
+        tsc_value breakdown = tsc_object();
+        tsc_setKey(breakdown, "reset", tsc_number(r->resetTime * 1000));
+        for(size_t j = 0; j < subticks.subc; j++) {
+            tsc_setKey(breakdown, subticks.subs[j].name, tsc_number(r->subtickTimes[j] * 1000));
+        }
+        tsc_setKey(obj, "subtickMeanMs", breakdown);
+        tsc_destroy(breakdown);
+        tsc_setKey(obj, "conflicts", tsc_int(r->conflicts));
+        if(verify) {
+            tsc_value divergence = tsc_null();
+            if(r->diverged) {
+                divergence = tsc_object();
+                tsc_setKey(divergence, "tick", tsc_int(r->divergedTick));
+                tsc_setKey(divergence, "subtick", tsc_cstring(r->divergence.subtick));
+                tsc_setKey(divergence, "x", tsc_int(r->divergence.x));
+                tsc_setKey(divergence, "y", tsc_int(r->divergence.y));
+                tsc_setKey(divergence, "cells", tsc_int(r->divergence.cells));
+                tsc_setKey(divergence, "conflicts", tsc_int(r->divergence.conflicts));
+            }
+            tsc_setKey(obj, "divergence", divergence);
+            tsc_destroy(divergence);
+        }
+        tsc_append(list, obj);
+        tsc_destroy(obj);
+    }
+    tsc_buffer json = tsc_json_encode(list, NULL);
+    tsc_saving_writeBytes(out, json.mem, json.len);
+    tsc_saving_write(out, '\n');
+    tsc_saving_deleteBuffer(json);
+    tsc_destroy(list);
+}
+
+static void tsc_bench_writeCSV(tsc_buffer *out, tsc_bench_result *results, size_t resultc, bool verify) {
+    tsc_saving_writeStr(out, "name,width,height,threads,chunk_size,load_s,ticks,total_s,tps,mean_ms,median_ms,p99_ms,min_ms,max_ms,reset_ms");
+    for(size_t j = 0; j < subticks.subc; j++) {
+        tsc_saving_writeFormat(out, ",%s_ms", subticks.subs[j].name);
+    }
+    tsc_saving_writeStr(out, ",conflicts");
+    if(verify) {
+        tsc_saving_writeStr(out, ",diverged,diverged_tick,diverged_subtick,diverged_x,diverged_y,diverged_cells,diverged_conflicts");
+    }
+    tsc_saving_write(out, '\n');
+    for(size_t i = 0; i < resultc; i++) {
+        tsc_bench_result *r = results + i;
+        // names come from a ;-separated file so they can have commas, but not quotes
+        tsc_saving_writeFormat(out, "\"%s\",%d,%d,%d,%d,%f,%lu,%f,%f,%f,%f,%f,%f,%f,%f",
+            r->name, r->width, r->height, r->threads, r->chunkSize, r->loadTime, (unsigned long)r->ticks, r->totalTime, r->tps,
+            r->meanTick * 1000, r->medianTick * 1000, r->p99Tick * 1000, r->minTick * 1000, r->maxTick * 1000, r->resetTime * 1000);
+        for(size_t j = 0; j < subticks.subc; j++) {
+            tsc_saving_writeFormat(out, ",%f", r->subtickTimes[j] * 1000);
+        }
+        tsc_saving_writeFormat(out, ",%lu", (unsigned long)r->conflicts);
+        if(verify && r->diverged) {
+            tsc_saving_writeFormat(out, ",1,%lu,\"%s\",%d,%d,%lu,%lu", (unsigned long)r->divergedTick, r->divergence.subtick,
+                r->divergence.x, r->divergence.y, (unsigned long)r->divergence.cells, (unsigned long)r->divergence.conflicts);
+        } else if(verify) {
+            tsc_saving_writeStr(out, ",0,,,,,,");
+        }
+        tsc_saving_write(out, '\n');
+    }
+}
+
+int main(int argc, char **argv) {
+    srand(time(NULL));
+
+    const char *benchPath = NULL;
+    const char *filter = NULL;
+    const char *threads = NULL;
+    const char *format = "json";
+    const char *output = NULL;
+    size_t ticks = 100;
+    size_t warmup = 0;
+    double duration = 0;
+    bool listOnly = false;
+    bool verify = false;
+
+    for(int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        if(strncmp(arg, "--benches=", 10) == 0) {
+            benchPath = arg + 10;
+        } else if(strncmp(arg, "--filter=", 9) == 0) {
+            filter = arg + 9;
+        } else if(strncmp(arg, "--ticks=", 8) == 0) {
+            ticks = strtoull(arg + 8, NULL, 10);
+        } else if(strncmp(arg, "--duration=", 11) == 0) {
+            duration = atof(arg + 11);
+        } else if(strncmp(arg, "--warmup=", 9) == 0) {
+            warmup = strtoull(arg + 9, NULL, 10);
+        } else if(strncmp(arg, "--threads=", 10) == 0) {
+            threads = arg + 10;
+        } else if(strncmp(arg, "--chunkSize=", 12) == 0) {
+            tsc_gridChunkSize = strtoull(arg + 12, NULL, 10);
+            if(tsc_gridChunkSize == 0) tsc_gridChunkSize = TSC_DEFAULT_CHUNK_SIZE;
+        } else if(strncmp(arg, "--format=", 9) == 0) {
+            format = arg + 9;
+        } else if(strncmp(arg, "--output=", 9) == 0) {
+            output = arg + 9;
+        } else if(strcmp(arg, "--verify") == 0) {
+            verify = true;
+        } else if(strcmp(arg, "--list") == 0) {
+            listOnly = true;
+        } else {
+            tsc_bench_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(!tsc_streql(format, "json") && !tsc_streql(format, "csv")) {
+        fprintf(stderr, "Error: unknown format %s\n", format);
+        return 1;
+    }
+
+    char defaultBenchPath[] = "data/benches.txt";
+    tsc_pathfix(defaultBenchPath);
+    if(benchPath == NULL) benchPath = defaultBenchPath;
+
+    char *benchText = tsc_allocfile(benchPath, NULL);
+    if(benchText == NULL) {
+        fprintf(stderr, "Error: unable to read %s\n", benchPath);
+        return 1;
+    }
+    char **benchLines = tsc_alloclines(benchText, NULL);
+    tsc_freefile(benchText);
+
+    workers_setupBest();
+
+    tsc_init_builtin_ids();
+    tsc_subtick_addCore();
+    tsc_saving_registerCore();
+    tsc_loadSettings();
+
+    storeExtraGraphicInfo = false;
+
+    if(threads != NULL) {
+        workers_setAmount(atoi(threads));
+    }
+
+    size_t resultc = 0;
+    tsc_bench_result *results = NULL;
+    bool diverged = false;
+
+    for(size_t i = 0; benchLines[i] != NULL; i++) {
+        char *line = benchLines[i];
+        char *sep = strchr(line, ';');
+        if(sep == NULL) continue;
+        *sep = '\0';
+        const char *name = line;
+        const char *level = sep + 1;
+        if(!tsc_bench_matches(name, filter)) continue;
+        if(listOnly) {
+            printf("%s\n", name);
+            continue;
+        }
+        if(tsc_saving_identify(level) == NULL) {
+            fprintf(stderr, "Skipping %s: unknown level format\n", name);
+            continue;
+        }
+
+        fprintf(stderr, "Running %s\n", name);
+        tsc_bench_result result = tsc_bench_run(name, level, ticks, duration, warmup, verify);
+        fprintf(stderr, "%s: %lu ticks, %.2f TPS, mean %.3fms, p99 %.3fms\n", name, (unsigned long)result.ticks, result.tps, result.meanTick * 1000, result.p99Tick * 1000);
+        if(result.diverged) {
+            fprintf(stderr, "%s: tick %lu diverged from the serial run after %s at %d,%d (%lu cells differ, %lu conflicts)\n", name, (unsigned long)result.divergedTick,
+                result.divergence.subtick, result.divergence.x, result.divergence.y, (unsigned long)result.divergence.cells,
+                (unsigned long)result.divergence.conflicts);
+            diverged = true;
+        }
+
+        results = realloc(results, sizeof(tsc_bench_result) * (resultc + 1));
+        results[resultc++] = result;
+    }
+
+    if(listOnly) return 0;
+
+    tsc_buffer out = tsc_saving_newBuffer("");
+    if(tsc_streql(format, "json")) {
+        tsc_bench_writeJSON(&out, results, resultc, verify);
+    } else {
+        tsc_bench_writeCSV(&out, results, resultc, verify);
+    }
+
+    FILE *f = output == NULL ? stdout : fopen(output, "w");
+    if(f == NULL) {
+        fprintf(stderr, "Error: unable to open %s\n", output);
+        return 1;
+    }
+    fwrite(out.mem, sizeof(char), out.len, f);
+    if(f != stdout) fclose(f);
+    tsc_saving_deleteBuffer(out);
+
+    for(size_t i = 0; i < resultc; i++) {
+        free(results[i].subtickTimes);
+    }
+    free(results);
+    tsc_freelines(benchLines);
+
+    return diverged ? 2 : 0;
+}
@@ -1,29 +1,142 @@
 #include "grid.h"
 #include "../utils.h"
-#include "../graphics/resources.h"
+#include "../engine.h"
 #include "../api/api.h"
 #include "ticking.h"
+#include "../threads/threads.h"
 #include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 
-tsc_cell tsc_trashedCellBuffer[TSC_MAX_TRASHED] = {0};
-atomic_size_t tsc_trashedCellCount = 0;
+// Every thread which trashes anything gets its own buffer, so workers never fight over a counter.
+// They're merged into one of three published buffers at the end of the tick, which the renderer reads from.
+typedef struct tsc_trash_ring_t {
+    tsc_trashed_cell_t *cells;
+    size_t len;
+    size_t cap;
+    // Cleared when the thread using it exits, so the next new thread can have it instead of growing the list
+    atomic_bool owned;
+    struct tsc_trash_ring_t *next;
+} tsc_trash_ring_t;
+
+typedef struct tsc_trash_published_t {
+    tsc_trashed_cell_t *cells;
+    size_t len;
+    size_t cap;
+} tsc_trash_published_t;
+
+// Rings are only ever added, never removed, so walking the list is always safe.
+static _Atomic(tsc_trash_ring_t *) tsc_trashRings = NULL;
+static _Thread_local tsc_trash_ring_t *tsc_ownTrashRing = NULL;
+static tss_t tsc_trashRingKey;
+static once_flag tsc_trashRingKeyOnce = ONCE_FLAG_INIT;
+// Several ticks can finish during one frame, so the publisher needs a buffer which is neither the front one nor the one
+// the renderer is still reading (which might be an older front one). That's 3.
+static tsc_trash_published_t tsc_trashPublished[3] = {{NULL, 0, 0}, {NULL, 0, 0}, {NULL, 0, 0}};
+static atomic_int tsc_trashFront = 0;
+// The buffer being read from, or -1
+static atomic_int tsc_trashPinned = -1;
+
+static void tsc_releaseTrashRing(void *ring) {
+    atomic_store(&((tsc_trash_ring_t *)ring)->owned, false);
+}
+
+static void tsc_setupTrashRingKey() {
+    tss_create(&tsc_trashRingKey, tsc_releaseTrashRing);
+}
+
+static tsc_trash_ring_t *tsc_getTrashRing() {
+    if(tsc_ownTrashRing != NULL) return tsc_ownTrashRing;
+    call_once(&tsc_trashRingKeyOnce, tsc_setupTrashRingKey);
+    tsc_trash_ring_t *ring = NULL;
+    // Take over the ring of a thread which is gone
+    for(tsc_trash_ring_t *old = atomic_load(&tsc_trashRings); old != NULL; old = old->next) {
+        bool owned = false;
+        if(atomic_compare_exchange_strong(&old->owned, &owned, true)) {
+            ring = old;
+            break;
+        }
+    }
+    if(ring == NULL) {
+        ring = malloc(sizeof(tsc_trash_ring_t));
+        ring->cells = NULL;
+        ring->len = 0;
+        ring->cap = 0;
+        atomic_init(&ring->owned, true);
+        ring->next = atomic_load(&tsc_trashRings);
+        while(!atomic_compare_exchange_weak(&tsc_trashRings, &ring->next, ring));
+    }
+    tss_set(tsc_trashRingKey, ring);
+    tsc_ownTrashRing = ring;
+    return ring;
+}
 
 void tsc_trashCell(tsc_cell *cell, int x, int y) {
 #ifndef TSC_TURBO
     if(!storeExtraGraphicInfo) return;
-    tsc_cell trashed = *cell;
-    trashed.reg = 0;
-    trashed.reg |= (x << 16) | (y & 0xFFFF); // encode x,y in this
-    size_t idx = atomic_fetch_add(&tsc_trashedCellCount, 1);
-    if(idx < TSC_MAX_TRASHED) {
-        tsc_trashedCellBuffer[idx] = trashed;
+    tsc_trash_ring_t *ring = tsc_getTrashRing();
+    if(ring->len == ring->cap) {
+        if(ring->cap == TSC_MAX_TRASHED) return;
+        ring->cap = ring->cap == 0 ? 256 : ring->cap * 2;
+        if(ring->cap > TSC_MAX_TRASHED) ring->cap = TSC_MAX_TRASHED;
+        ring->cells = realloc(ring->cells, sizeof(tsc_trashed_cell_t) * ring->cap);
+    }
+    tsc_trashed_cell_t *trashed = ring->cells + ring->len++;
+    trashed->cell = *cell;
+    trashed->x = x;
+    trashed->y = y;
+#endif
+}
+
+void tsc_publishTrashedCells() {
+#ifndef TSC_TURBO
+    int front = atomic_load(&tsc_trashFront);
+    int pinned = atomic_load(&tsc_trashPinned);
+    int back = 0;
+    while(back == front || back == pinned) back++;
+    tsc_trash_published_t *published = tsc_trashPublished + back;
+    published->len = 0;
+    for(tsc_trash_ring_t *ring = atomic_load(&tsc_trashRings); ring != NULL; ring = ring->next) {
+        size_t len = ring->len;
+        if(published->len + len > TSC_MAX_TRASHED) len = TSC_MAX_TRASHED - published->len;
+        if(published->len + len > published->cap) {
+            published->cap = published->len + len;
+            published->cells = realloc(published->cells, sizeof(tsc_trashed_cell_t) * published->cap);
+        }
+        memcpy(published->cells + published->len, ring->cells, sizeof(tsc_trashed_cell_t) * len);
+        published->len += len;
+        ring->len = 0;
     }
+    atomic_store(&tsc_trashFront, back);
 #endif
 }
 
+tsc_trashed_cell_t *tsc_getTrashedCells(size_t *len) {
+    // If a tick got published in between, the pin might be on a buffer the publisher already picked, so check again
+    int front;
+    do {
+        front = atomic_load(&tsc_trashFront);
+        atomic_store(&tsc_trashPinned, front);
+    } while(atomic_load(&tsc_trashFront) != front);
+    tsc_trash_published_t *published = tsc_trashPublished + front;
+    *len = published->len;
+    return published->cells;
+}
+
+void tsc_releaseTrashedCells() {
+    atomic_store(&tsc_trashPinned, -1);
+}
+
+void tsc_clearTrashedCells() {
+    for(tsc_trash_ring_t *ring = atomic_load(&tsc_trashRings); ring != NULL; ring = ring->next) {
+        ring->len = 0;
+    }
+    for(int i = 0; i < 3; i++) {
+        tsc_trashPublished[i].len = 0;
+    }
+}
+
 tsc_cell_id_pool_t builtin;
 
 void tsc_init_builtin_ids() {
@@ -60,6 +173,9 @@ void tsc_init_builtin_ids() {
     builtin.optimizations.gens[1] = tsc_allocOptimization("gen1");
     builtin.optimizations.gens[2] = tsc_allocOptimization("gen2");
     builtin.optimizations.gens[3] = tsc_allocOptimization("gen3");
+
+    builtin.forces.push = tsc_registerForceType("push");
+    builtin.forces.pull = tsc_registerForceType("pull");
 }
 
 tsc_cell __attribute__((hot)) tsc_cell_create(tsc_id_t id, char rot) {
@@ -114,12 +230,14 @@ void tsc_cell_setRotationData(tsc_cell *cell, signed char rot, signed char added
     rot %= 4;
     while(rot < 0) rot += 4;
     cell->rotData = (addedRot << 2) | rot;
+    tsc_grid_trackCell(cell);
 }
 
 void tsc_cell_swap(tsc_cell *a, tsc_cell *b) {
     tsc_cell c = *a;
     *a = *b;
     *b = c;
+    tsc_grid_trackSwap(a, b);
 }
 
 typedef struct tsc_cell_table_arr {
@@ -131,6 +249,8 @@ typedef struct tsc_cell_table_arr {
 static tsc_cell_table_arr cell_table_arr = {NULL, NULL, 0};
 static tsc_celltable tsc_cellTables[TSC_ID_COUNT];
 static bool tsc_cellTablesDefined[TSC_ID_COUNT] = {false};
+// Nothing is known until the first refresh
+unsigned char tsc_cellCapabilities[TSC_ID_COUNT] = {0};
 
 tsc_celltable *tsc_cell_newTable(tsc_id_t id) {
     if(!tsc_cellTablesDefined[id]) {
@@ -151,13 +271,79 @@ tsc_celltable *tsc_cell_getTable(tsc_cell *cell) {
     return NULL;
 }
 
+bool tsc_cell_startUpdate(tsc_cell_update_t *update) {
+    tsc_cell *cell = update->cell;
+    if(cell->id != update->id) return false;
+    #ifndef TSC_TURBO
+    if(update->tracked) {
+        if(cell->updated) return false;
+        cell->updated = true;
+        tsc_grid_markUpdated(currentGrid, update->x, update->y);
+    }
+    #endif
+    return true;
+}
+
 size_t tsc_cell_getTableFlags(tsc_cell *cell) {
     tsc_celltable *table = tsc_cell_getTable(cell);
     if(table == NULL) return 0;
     return table->flags;
 }
 
-int tsc_cell_canMove(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force) {
+void tsc_cell_refreshCapabilities() {
+    size_t idc = tsc_countCells();
+    for(size_t id = 0; id < idc; id++) {
+        tsc_celltable *table = tsc_cellTablesDefined[id] ? tsc_cellTables + id : NULL;
+        unsigned char caps = 0;
+        bool noMove = table == NULL || table->canMove == NULL;
+        bool noBias = table == NULL || table->getBias == NULL;
+        bool noTrash = table == NULL || table->isTrash == NULL;
+        // isAcid is only asked if there's an onAcid
+        bool noAcid = table == NULL || table->onAcid == NULL;
+        bool noGenerate = table == NULL || table->canGenerate == NULL;
+        if(noMove && id != builtin.wall && id != builtin.slide) caps |= TSC_CAP_MOVABLE;
+        if(noBias && id != builtin.mover) caps |= TSC_CAP_NO_BIAS;
+        if(noTrash && id != builtin.trash && id != builtin.enemy) caps |= TSC_CAP_NOT_TRASH;
+        if(noAcid) caps |= TSC_CAP_NOT_ACID;
+        if(noGenerate && id != builtin.empty) caps |= TSC_CAP_CAN_GENERATE;
+        if(noMove && noBias && noTrash && noAcid && noGenerate) caps |= TSC_CAP_NO_HOOKS;
+        tsc_cellCapabilities[id] = caps;
+    }
+}
+
+unsigned char tsc_cell_getCapabilities(tsc_id_t id) {
+    return tsc_cellCapabilities[id];
+}
+
+static const char *tsc_forceTypes[TSC_MAX_FORCE_TYPES];
+static size_t tsc_forceTypeCount = 0;
+
+// No interning here, since mods can call the string versions from any thread
+tsc_force_t tsc_findForceType(const char *name) {
+    if(name == NULL) return TSC_UNKNOWN_FORCE;
+    for(size_t i = 0; i < tsc_forceTypeCount; i++) {
+        if(tsc_forceTypes[i] == name || tsc_streql(tsc_forceTypes[i], name)) return i;
+    }
+    return TSC_UNKNOWN_FORCE;
+}
+
+tsc_force_t tsc_registerForceType(const char *name) {
+    tsc_force_t existing = tsc_findForceType(name);
+    if(existing != TSC_UNKNOWN_FORCE) return existing;
+    if(tsc_forceTypeCount == TSC_MAX_FORCE_TYPES) return TSC_UNKNOWN_FORCE;
+    tsc_forceTypes[tsc_forceTypeCount] = tsc_strintern(name);
+    return tsc_forceTypeCount++;
+}
+
+const char *tsc_forceTypeName(tsc_force_t forceType) {
+    if(forceType >= tsc_forceTypeCount) return NULL;
+    return tsc_forceTypes[forceType];
+}
+
+// The string versions pass along the name they got, so tables still see names which were never registered
+
+static int tsc_cell_doCanMove(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, const char *name, double force) {
+    if(tsc_cellCapabilities[cell->id] & TSC_CAP_MOVABLE) return 1;
     char rot = tsc_cell_getRotation(cell);
     if(cell->id == builtin.wall) return 0;
     if(cell->id == builtin.slide) return  dir % 2 == rot % 2;
@@ -165,12 +351,13 @@ int tsc_cell_canMove(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, con
     tsc_celltable *celltable = tsc_cell_getTable(cell);
     if(celltable == NULL) return 1;
     if(celltable->canMove == NULL) return 1;
-    return celltable->canMove(grid, cell, x, y, dir, forceType, force, celltable->payload);
+    return celltable->canMove(grid, cell, x, y, dir, name, force, celltable->payload);
 }
 
-float tsc_cell_getBias(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force) {
+static float tsc_cell_doGetBias(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, const char *name, double force) {
+    if(tsc_cellCapabilities[cell->id] & TSC_CAP_NO_BIAS) return 0;
     char rot = tsc_cell_getRotation(cell);
-    if(cell->id == builtin.mover && tsc_streql(forceType, "push")) {
+    if(cell->id == builtin.mover && forceType == builtin.forces.push) {
         if(rot == dir) return 1;
         if((rot + 2) % 4 == dir) return -1;
 
@@ -180,28 +367,20 @@ float tsc_cell_getBias(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, c
     tsc_celltable *celltable = tsc_cell_getTable(cell);
     if(celltable == NULL) return 0;
     if(celltable->getBias == NULL) return 0;
-    return celltable->getBias(grid, cell, x, y, dir, forceType, force, celltable->payload);
+    return celltable->getBias(grid, cell, x, y, dir, name, force, celltable->payload);
 }
 
-int tsc_cell_canGenerate(tsc_grid *grid, tsc_cell *cell, int x, int y, tsc_cell *generator, int gx, int gy, char dir) {
-    // Can't generate air
-    if(cell->id == builtin.empty) return 0;
-    tsc_celltable *celltable = tsc_cell_getTable(cell);
-    if(celltable == NULL) return 1;
-    if(celltable->canGenerate == NULL) return 1;
-    return celltable->canGenerate(grid, cell, x, y, generator, gx, gy, dir, celltable->payload);
-}
-
-int tsc_cell_isTrash(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force, tsc_cell *eating) {
+static int tsc_cell_doIsTrash(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, const char *name, double force, tsc_cell *eating) {
+    if(tsc_cellCapabilities[cell->id] & TSC_CAP_NOT_TRASH) return 0;
     if(cell->id == builtin.trash) return 1;
     if(cell->id == builtin.enemy) return 1;
     tsc_celltable *celltable = tsc_cell_getTable(cell);
     if(celltable == NULL) return 0;
     if(celltable->isTrash == NULL) return 0;
-    return celltable->isTrash(grid, cell, x, y, dir, forceType, force, eating, celltable->payload);
+    return celltable->isTrash(grid, cell, x, y, dir, name, force, eating, celltable->payload);
 }
 
-void tsc_cell_onTrash(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force, tsc_cell *eating) {
+static void tsc_cell_doOnTrash(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, const char *name, double force, tsc_cell *eating) {
     if(cell->id == builtin.enemy) {
         tsc_trashCell(cell, x, y);
         tsc_trashCell(eating, x, y);
@@ -216,21 +395,80 @@ void tsc_cell_onTrash(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, co
     tsc_celltable *celltable = tsc_cell_getTable(cell);
     if(celltable == NULL) return;
     if(celltable->onTrash == NULL) return;
-    return celltable->onTrash(grid, cell, x, y, dir, forceType, force, eating, celltable->payload);
+    return celltable->onTrash(grid, cell, x, y, dir, name, force, eating, celltable->payload);
 }
 
-int tsc_cell_isAcid(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy) {
+static int tsc_cell_doIsAcid(tsc_grid *grid, tsc_cell *cell, char dir, tsc_force_t forceType, const char *name, double force, tsc_cell *dissolving, int dx, int dy) {
+    if(tsc_cellCapabilities[cell->id] & TSC_CAP_NOT_ACID) return 0;
     tsc_celltable *celltable = tsc_cell_getTable(cell);
     if(celltable == NULL) return 0;
     if(celltable->onAcid == NULL) return 0;
-    return celltable->isAcid(grid, cell, dir, forceType, force, dissolving, dx, dy, celltable->payload);
+    return celltable->isAcid(grid, cell, dir, name, force, dissolving, dx, dy, celltable->payload);
 }
 
-void tsc_cell_onAcid(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy) {
+static void tsc_cell_doOnAcid(tsc_grid *grid, tsc_cell *cell, char dir, tsc_force_t forceType, const char *name, double force, tsc_cell *dissolving, int dx, int dy) {
     tsc_celltable *celltable = tsc_cell_getTable(cell);
     if(celltable == NULL) return;
     if(celltable->onAcid == NULL) return;
-    return celltable->onAcid(grid, cell, dir, forceType, force, dissolving, dx, dy, celltable->payload);
+    return celltable->onAcid(grid, cell, dir, name, force, dissolving, dx, dy, celltable->payload);
+}
+
+int tsc_cell_canMove(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force) {
+    return tsc_cell_doCanMove(grid, cell, x, y, dir, tsc_findForceType(forceType), forceType, force);
+}
+
+float tsc_cell_getBias(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force) {
+    return tsc_cell_doGetBias(grid, cell, x, y, dir, tsc_findForceType(forceType), forceType, force);
+}
+
+int tsc_cell_canGenerate(tsc_grid *grid, tsc_cell *cell, int x, int y, tsc_cell *generator, int gx, int gy, char dir) {
+    if(tsc_cellCapabilities[cell->id] & TSC_CAP_CAN_GENERATE) return 1;
+    // Can't generate air
+    if(cell->id == builtin.empty) return 0;
+    tsc_celltable *celltable = tsc_cell_getTable(cell);
+    if(celltable == NULL) return 1;
+    if(celltable->canGenerate == NULL) return 1;
+    return celltable->canGenerate(grid, cell, x, y, generator, gx, gy, dir, celltable->payload);
+}
+
+int tsc_cell_isTrash(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force, tsc_cell *eating) {
+    return tsc_cell_doIsTrash(grid, cell, x, y, dir, tsc_findForceType(forceType), forceType, force, eating);
+}
+
+void tsc_cell_onTrash(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force, tsc_cell *eating) {
+    tsc_cell_doOnTrash(grid, cell, x, y, dir, tsc_findForceType(forceType), forceType, force, eating);
+}
+
+int tsc_cell_isAcid(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy) {
+    return tsc_cell_doIsAcid(grid, cell, dir, tsc_findForceType(forceType), forceType, force, dissolving, dx, dy);
+}
+
+void tsc_cell_onAcid(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy) {
+    tsc_cell_doOnAcid(grid, cell, dir, tsc_findForceType(forceType), forceType, force, dissolving, dx, dy);
+}
+
+int tsc_cell_canMoveWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force) {
+    return tsc_cell_doCanMove(grid, cell, x, y, dir, forceType, tsc_forceTypeName(forceType), force);
+}
+
+float tsc_cell_getBiasWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force) {
+    return tsc_cell_doGetBias(grid, cell, x, y, dir, forceType, tsc_forceTypeName(forceType), force);
+}
+
+int tsc_cell_isTrashWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force, tsc_cell *eating) {
+    return tsc_cell_doIsTrash(grid, cell, x, y, dir, forceType, tsc_forceTypeName(forceType), force, eating);
+}
+
+void tsc_cell_onTrashWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force, tsc_cell *eating) {
+    tsc_cell_doOnTrash(grid, cell, x, y, dir, forceType, tsc_forceTypeName(forceType), force, eating);
+}
+
+int tsc_cell_isAcidWith(tsc_grid *grid, tsc_cell *cell, char dir, tsc_force_t forceType, double force, tsc_cell *dissolving, int dx, int dy) {
+    return tsc_cell_doIsAcid(grid, cell, dir, forceType, tsc_forceTypeName(forceType), force, dissolving, dx, dy);
+}
+
+void tsc_cell_onAcidWith(tsc_grid *grid, tsc_cell *cell, char dir, tsc_force_t forceType, double force, tsc_cell *dissolving, int dx, int dy) {
+    tsc_cell_doOnAcid(grid, cell, dir, forceType, tsc_forceTypeName(forceType), force, dissolving, dx, dy);
 }
 
 char *tsc_cell_signal(tsc_cell *cell, int x, int y, const char *protocol, const char *data, tsc_cell *sender, int sx, int sy) {
@@ -1,7 +1,7 @@
 #include "grid.h"
 #include "../utils.h"
 #include "../api/api.h"
-#include "../graphics/resources.h"
+#include "../engine.h"
 #include "../threads/workers.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -11,7 +11,12 @@
 
 tsc_grid *currentGrid = NULL;
 tsc_gridStorage *gridStorage = NULL;
-size_t tsc_gridChunkSize = 25;
+size_t tsc_gridChunkSize = TSC_DEFAULT_CHUNK_SIZE;
+
+static void tsc_grid_freeIndices(tsc_grid *grid);
+static void tsc_grid_indexChanged(tsc_grid *grid, int x, int y, tsc_id_t oldID, tsc_id_t newID);
+static bool tsc_grid_indicesValid(tsc_grid *grid);
+static void tsc_grid_resetAll(tsc_grid *grid);
 
 tsc_grid *tsc_getGrid(const char *name) {
     if(gridStorage == NULL) return NULL;
@@ -34,11 +39,33 @@ static void tsc_initPartOfGrid(tsc_grid_init_task_t *task) {
     memset(task->grid->cells + off, 0, sizeof(tsc_cell) * task->grid->width);
     memset(task->grid->bgs + off, 0, sizeof(tsc_cell) * task->grid->width);
     memset(task->grid->optData + (off) * tsc_optSize(), 0, tsc_optSize() * task->grid->width);
-    for(size_t x = 0; x < task->grid->width; x += tsc_gridChunkSize) {
+    for(size_t x = 0; x < task->grid->width; x += 1 << task->grid->chunkshift) {
         tsc_grid_disableChunk(task->grid, x, task->y);
     }
 }
 
+// Everything starts out disabled
+static void tsc_grid_allocChunks(tsc_grid *grid, int width, int height) {
+    int shift = 0;
+    while(((size_t)1 << shift) < tsc_gridChunkSize) shift++;
+    grid->chunkshift = shift;
+
+    // that + is to fight integer division rounding
+    int chunkWidth = (width >> shift) + 1;
+    int chunkHeight = (height >> shift) + 1;
+
+    grid->chunkwidth = chunkWidth;
+    grid->chunkheight = chunkHeight;
+    grid->chunkwords = (chunkWidth + 63) / 64;
+
+    free(grid->chunkdata);
+    free(grid->chunkRowCounts);
+    free(grid->chunkColumnCounts);
+    grid->chunkdata = calloc(grid->chunkwords * chunkHeight, sizeof(atomic_ullong));
+    grid->chunkRowCounts = calloc(chunkHeight, sizeof(atomic_int));
+    grid->chunkColumnCounts = calloc(chunkWidth, sizeof(atomic_int));
+}
+
 tsc_grid *tsc_createGrid(const char *id, int width, int height, const char *title, const char *description) {
     if(gridStorage == NULL) {
         gridStorage = malloc(sizeof(tsc_gridStorage));
@@ -58,16 +85,23 @@ tsc_grid *tsc_createGrid(const char *id, int width, int height, const char *titl
     grid->title = tsc_strintern(title);
     grid->desc = tsc_strintern(description);
 
-    // that + is to fight integer division rounding
-    int chunkWidth = width / tsc_gridChunkSize + 1;
-    int chunkHeight = height / tsc_gridChunkSize + 1;
-
-    grid->chunkwidth = chunkWidth;
-    grid->chunkheight = chunkHeight;
-
-    grid->chunkdata = malloc(sizeof(bool) * chunkWidth * chunkHeight);
+    grid->chunkdata = NULL;
+    grid->chunkRowCounts = NULL;
+    grid->chunkColumnCounts = NULL;
+    tsc_grid_allocChunks(grid, width, height);
 
     grid->refc = 1;
+    grid->indices = NULL;
+    grid->indexc = 0;
+    grid->indexGeneration = 0;
+    grid->idPlane = NULL;
+    grid->dirty = NULL;
+    grid->dirtyRows = NULL;
+    grid->changed = NULL;
+    grid->rowStamps = NULL;
+    grid->columnStamps = NULL;
+    grid->epoch = 0;
+    grid->blocked = NULL;
     size_t len = width * height;
     grid->cells = malloc(sizeof(tsc_cell) * len);
     grid->bgs = malloc(sizeof(tsc_cell) * len);
@@ -122,6 +156,9 @@ void tsc_deleteGrid(tsc_grid *grid) {
     free(grid->cells);
     free(grid->bgs);
     free(grid->chunkdata);
+    free(grid->chunkRowCounts);
+    free(grid->chunkColumnCounts);
+    tsc_grid_freeIndices(grid);
     free(grid);
 }
 
@@ -131,6 +168,8 @@ void tsc_switchGrid(tsc_grid *grid) {
     }
     currentGrid = grid;
     tsc_retainGrid(currentGrid);
+    // It could've been changed with swaps while it wasn't the current grid
+    tsc_grid_invalidateIndices(currentGrid);
 }
 
 typedef struct tsc_grid_copy_task_t {
@@ -183,14 +222,11 @@ void tsc_clearGrid(tsc_grid *grid, int width, int height) {
 
         free(buffer);
     }
+    tsc_grid_invalidateIndices(grid);
     size_t len = width * height;
     grid->cells = realloc(grid->cells, sizeof(tsc_cell) * len);
     grid->bgs = realloc(grid->bgs, sizeof(tsc_cell) * len);
-    int chunkWidth = width / tsc_gridChunkSize + 1;
-    int chunkHeight = height / tsc_gridChunkSize + 1;
-    grid->chunkdata = realloc(grid->chunkdata, sizeof(bool) * chunkWidth * chunkHeight);
-    grid->chunkwidth = chunkWidth;
-    grid->chunkheight = chunkHeight;
+    tsc_grid_allocChunks(grid, width, height);
     grid->width = width;
     grid->height = height;
     grid->optData = realloc(grid->optData, sizeof(char) * width * height * tsc_optSize());
@@ -212,6 +248,41 @@ void tsc_clearGrid(tsc_grid *grid, int width, int height) {
     }
 }
 
+static bool tsc_grid_sameCell(tsc_cell *a, tsc_cell *b) {
+    if(a->id != b->id) return false;
+    if(a->rotData != b->rotData) return false;
+#ifndef TSC_TURBO
+    if(a->texture != b->texture) return false;
+    if(a->updated != b->updated) return false;
+    if(a->effect != b->effect) return false;
+    if(a->reg != b->reg) return false;
+    if(a->lx != b->lx) return false;
+    if(a->ly != b->ly) return false;
+#endif
+    return true;
+}
+
+size_t tsc_diffGrids(tsc_grid *a, tsc_grid *b, int *x, int *y) {
+    *x = 0;
+    *y = 0;
+    if(a->width != b->width || a->height != b->height) {
+        int width = a->width > b->width ? a->width : b->width;
+        int height = a->height > b->height ? a->height : b->height;
+        return (size_t)width * height;
+    }
+    size_t diff = 0;
+    size_t len = a->width * a->height;
+    for(size_t i = 0; i < len; i++) {
+        if(tsc_grid_sameCell(a->cells + i, b->cells + i) && tsc_grid_sameCell(a->bgs + i, b->bgs + i)) continue;
+        if(diff == 0) {
+            *x = i % a->width;
+            *y = i / a->width;
+        }
+        diff++;
+    }
+    return diff;
+}
+
 void tsc_nukeGrids() {
     if(gridStorage == NULL) {
         return;
@@ -278,16 +349,51 @@ tsc_cell *tsc_grid_get(tsc_grid *grid, int x, int y) {
     return grid->cells + (x + y * grid->width);
 }
 
+static _Thread_local size_t *tsc_grid_conflicts = NULL;
+static _Thread_local char tsc_grid_claimAxis = 0;
+static _Thread_local int tsc_grid_claimedLine = 0;
+
+void tsc_grid_claimLine(size_t *conflicts, char axis, int line) {
+    tsc_grid_conflicts = conflicts;
+    tsc_grid_claimAxis = axis;
+    tsc_grid_claimedLine = line;
+}
+
+void tsc_grid_releaseLine() {
+    tsc_grid_conflicts = NULL;
+}
+
+static bool tsc_grid_isClaimed(tsc_grid *grid) {
+    return tsc_grid_conflicts != NULL && grid == currentGrid;
+}
+
+static bool tsc_grid_onClaimedLine(int x, int y) {
+    return tsc_grid_claimAxis == 0 ? y == tsc_grid_claimedLine : x == tsc_grid_claimedLine;
+}
+
+// Pushes and pulls stay on the line if they start on it and go along it. Even failing ones look at the cells in the way.
+static void tsc_grid_checkLine(tsc_grid *grid, int x, int y, char dir) {
+    if(!tsc_grid_isClaimed(grid)) return;
+    if(!tsc_grid_onClaimedLine(x, y) || (dir & 1) != tsc_grid_claimAxis) {
+        (*tsc_grid_conflicts)++;
+    }
+}
+
 void tsc_grid_set(tsc_grid *grid, int x, int y, tsc_cell *cell) {
     if(x < 0 || y < 0 || x >= grid->width || y >= grid->height) return;
     tsc_cell copy = tsc_cell_clone(cell);
     tsc_cell *old = tsc_grid_get(grid, x, y);
+    tsc_id_t oldID = old->id;
     tsc_cell_destroy(*old);
 #ifndef TSC_TURBO
     if(copy.lx == TSC_NULL_LAST) copy.lx = x;
     if(copy.ly == TSC_NULL_LAST) copy.ly = y;
 #endif
     *old = copy;
+    if(oldID != copy.id) {
+        tsc_grid_indexChanged(grid, x, y, oldID, copy.id);
+    }
+    tsc_grid_markDirty(grid, x, y);
     if(copy.id != builtin.empty) {
         tsc_grid_enableChunk(grid, x, y);
     }
@@ -339,45 +445,104 @@ int tsc_grid_shiftY(int y, char dir, int amount) {
 
 void tsc_grid_enableChunk(tsc_grid *grid, int x, int y) {
     if(tsc_grid_get(grid, x, y) == NULL) return;
-    int cx = x / tsc_gridChunkSize;
-    int cy = y / tsc_gridChunkSize;
-    grid->chunkdata[cy * grid->chunkwidth + cx] = true;
+    int cx = x >> grid->chunkshift;
+    int cy = y >> grid->chunkshift;
+    atomic_ullong *word = grid->chunkdata + cy * grid->chunkwords + cx / 64;
+    unsigned long long bit = 1ULL << (cx % 64);
+    // This is called on every single move, so don't do an atomic write if it's already on
+    if(atomic_load_explicit(word, memory_order_relaxed) & bit) return;
+    if(atomic_fetch_or_explicit(word, bit, memory_order_relaxed) & bit) return;
+    atomic_fetch_add_explicit(grid->chunkRowCounts + cy, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(grid->chunkColumnCounts + cx, 1, memory_order_relaxed);
 }
 
 void tsc_grid_disableChunk(tsc_grid *grid, int x, int y) {
     if(tsc_grid_get(grid, x, y) == NULL) return;
-    int cx = x / tsc_gridChunkSize;
-    int cy = y / tsc_gridChunkSize;
-    grid->chunkdata[cy * grid->chunkwidth + cx] = false;
+    int cx = x >> grid->chunkshift;
+    int cy = y >> grid->chunkshift;
+    atomic_ullong *word = grid->chunkdata + cy * grid->chunkwords + cx / 64;
+    unsigned long long bit = 1ULL << (cx % 64);
+    if(!(atomic_load_explicit(word, memory_order_relaxed) & bit)) return;
+    if(!(atomic_fetch_and_explicit(word, ~bit, memory_order_relaxed) & bit)) return;
+    atomic_fetch_sub_explicit(grid->chunkRowCounts + cy, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(grid->chunkColumnCounts + cx, 1, memory_order_relaxed);
 }
 
 bool tsc_grid_checkChunk(tsc_grid *grid, int x, int y) {
     if(tsc_grid_get(grid, x, y) == NULL) return false;
-    int cx = x / tsc_gridChunkSize;
-    int cy = y / tsc_gridChunkSize;
-    return grid->chunkdata[cy * grid->chunkwidth + cx];
+    int cx = x >> grid->chunkshift;
+    int cy = y >> grid->chunkshift;
+    return (atomic_load_explicit(grid->chunkdata + cy * grid->chunkwords + cx / 64, memory_order_relaxed) >> (cx % 64)) & 1;
 }
 
 bool tsc_grid_checkRow(tsc_grid *grid, int y) {
-    for(int x = 0; x < grid->width; x += tsc_gridChunkSize) {
-        if(tsc_grid_checkChunk(grid, x, y)) return true;
-    }
-    return false;
+    if(y < 0 || y >= grid->height) return false;
+    return atomic_load_explicit(grid->chunkRowCounts + (y >> grid->chunkshift), memory_order_relaxed) > 0;
 }
 
 bool tsc_grid_checkColumn(tsc_grid *grid, int x) {
-    for(int y = 0; y < grid->height; y += tsc_gridChunkSize) {
-        if(tsc_grid_checkChunk(grid, x, y)) return true;
+    if(x < 0 || x >= grid->width) return false;
+    return atomic_load_explicit(grid->chunkColumnCounts + (x >> grid->chunkshift), memory_order_relaxed) > 0;
+}
+
+static bool tsc_grid_isChunkEmpty(tsc_grid *grid, int cx, int cy) {
+    int sx = cx << grid->chunkshift;
+    int sy = cy << grid->chunkshift;
+    int ex = sx + (1 << grid->chunkshift);
+    int ey = sy + (1 << grid->chunkshift);
+    if(ex > grid->width) ex = grid->width;
+    if(ey > grid->height) ey = grid->height;
+    // Cells first since they're what is usually there, and the ID plane is way cheaper to scan
+    bool usePlane = tsc_grid_indicesValid(grid);
+    for(int y = sy; y < ey; y++) {
+        size_t row = y * grid->width;
+        for(int x = sx; x < ex; x++) {
+            tsc_id_t id = usePlane ? grid->idPlane[row + x] : grid->cells[row + x].id;
+            if(id != builtin.empty) return false;
+        }
     }
-    return false;
+    for(int y = sy; y < ey; y++) {
+        size_t row = y * grid->width;
+        for(int x = sx; x < ex; x++) {
+            if(grid->bgs[row + x].id != builtin.empty) return false;
+        }
+    }
+    return true;
 }
 
-int __attribute__((optnone)) tsc_grid_chunkOff(int x, int off) {
-    // int div handles it
-    x -= x % tsc_gridChunkSize;
-    int cx = x / tsc_gridChunkSize;
-    cx += off;
-    return cx * tsc_gridChunkSize;
+static void tsc_grid_sweepChunkRow(tsc_grid_init_task_t *task) {
+    tsc_grid *grid = task->grid;
+    int cy = task->y;
+    if(atomic_load_explicit(grid->chunkRowCounts + cy, memory_order_relaxed) == 0) return;
+    for(size_t w = 0; w < grid->chunkwords; w++) {
+        unsigned long long bits = atomic_load_explicit(grid->chunkdata + cy * grid->chunkwords + w, memory_order_relaxed);
+        while(bits != 0) {
+            int cx = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            if(!tsc_grid_isChunkEmpty(grid, cx, cy)) continue;
+            tsc_grid_disableChunk(grid, cx << grid->chunkshift, cy << grid->chunkshift);
+        }
+    }
+}
+
+void tsc_grid_sweepChunks(tsc_grid *grid) {
+    tsc_grid_init_task_t *buffer = malloc(sizeof(tsc_grid_init_task_t) * grid->chunkheight);
+    for(int cy = 0; cy < grid->chunkheight; cy++) {
+        buffer[cy].grid = grid;
+        buffer[cy].y = cy;
+    }
+    if(grid->width * grid->height < 100000) {
+        for(int cy = 0; cy < grid->chunkheight; cy++) {
+            tsc_grid_sweepChunkRow(buffer + cy);
+        }
+    } else {
+        workers_waitForTasksFlat((worker_task_t *)tsc_grid_sweepChunkRow, buffer, sizeof(tsc_grid_init_task_t), grid->chunkheight);
+    }
+    free(buffer);
+}
+
+int tsc_grid_chunkOff(tsc_grid *grid, int x, int off) {
+    return ((x >> grid->chunkshift) + off) << grid->chunkshift;
 }
 
 bool tsc_grid_checkOptimization(tsc_grid *grid, int x, int y, size_t optimization) {
@@ -394,9 +559,480 @@ void tsc_grid_setOptimization(tsc_grid *grid, int x, int y, size_t optimization,
     size_t size = tsc_optSize();
     size_t i = x + y * grid->width;
     tsc_setBit(grid->optData + i * size, optimization, enabled);
+    if(enabled) tsc_grid_markUpdated(grid, x, y);
+}
+
+// Which indices every ID belongs to, as a bitmask
+static uint64_t *tsc_indexedIDs = NULL;
+static size_t tsc_indexCount = 0;
+// Bumped whenever the indexed IDs change, so grids know to rebuild
+static size_t tsc_indexGeneration = 1;
+
+size_t tsc_grid_newIndex() {
+    if(tsc_indexCount == TSC_MAX_INDICES) return TSC_NO_INDEX;
+    if(tsc_indexedIDs == NULL) tsc_indexedIDs = calloc(TSC_ID_COUNT, sizeof(uint64_t));
+    tsc_indexGeneration++;
+    return tsc_indexCount++;
+}
+
+void tsc_grid_addIndexedID(size_t index, tsc_id_t id) {
+    if(index >= tsc_indexCount) return;
+    tsc_indexedIDs[id] |= (uint64_t)1 << index;
+    tsc_indexGeneration++;
+}
+
+void tsc_grid_invalidateIndices(tsc_grid *grid) {
+    grid->indexGeneration = 0;
+}
+
+static void tsc_grid_freeIndices(tsc_grid *grid) {
+    for(size_t i = 0; i < grid->indexc; i++) {
+        free(grid->indices[i].rows);
+        free(grid->indices[i].columns);
+        free(grid->indices[i].rowCounts);
+        free(grid->indices[i].columnCounts);
+    }
+    free(grid->indices);
+    grid->indices = NULL;
+    grid->indexc = 0;
+    free(grid->idPlane);
+    grid->idPlane = NULL;
+    free(grid->dirty);
+    grid->dirty = NULL;
+    free(grid->dirtyRows);
+    grid->dirtyRows = NULL;
+    free(grid->changed);
+    grid->changed = NULL;
+    free(grid->rowStamps);
+    grid->rowStamps = NULL;
+    free(grid->columnStamps);
+    grid->columnStamps = NULL;
+    free(grid->blocked);
+    grid->blocked = NULL;
+}
+
+static size_t tsc_grid_rowWords(tsc_grid *grid) {
+    return (grid->width + 63) / 64;
+}
+
+static size_t tsc_grid_columnWords(tsc_grid *grid) {
+    return (grid->height + 63) / 64;
+}
+
+static bool tsc_grid_indicesValid(tsc_grid *grid) {
+    return grid->indexGeneration == tsc_indexGeneration;
+}
+
+static void tsc_grid_indexAdd(tsc_grid *grid, tsc_grid_index *index, int x, int y) {
+    unsigned long long rowBit = 1ULL << (x % 64);
+    unsigned long long old = atomic_fetch_or_explicit(index->rows + y * tsc_grid_rowWords(grid) + x / 64, rowBit, memory_order_relaxed);
+    // Already there, no need to touch the column
+    if(old & rowBit) return;
+    unsigned long long columnBit = 1ULL << (y % 64);
+    atomic_fetch_or_explicit(index->columns + x * tsc_grid_columnWords(grid) + y / 64, columnBit, memory_order_relaxed);
+    atomic_fetch_add_explicit(index->rowCounts + y, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(index->columnCounts + x, 1, memory_order_relaxed);
+}
+
+static void tsc_grid_indexRemove(tsc_grid *grid, tsc_grid_index *index, int x, int y) {
+    unsigned long long rowBit = 1ULL << (x % 64);
+    unsigned long long old = atomic_fetch_and_explicit(index->rows + y * tsc_grid_rowWords(grid) + x / 64, ~rowBit, memory_order_relaxed);
+    if(!(old & rowBit)) return;
+    unsigned long long columnBit = 1ULL << (y % 64);
+    atomic_fetch_and_explicit(index->columns + x * tsc_grid_columnWords(grid) + y / 64, ~columnBit, memory_order_relaxed);
+    atomic_fetch_sub_explicit(index->rowCounts + y, 1, memory_order_relaxed);
+    atomic_fetch_sub_explicit(index->columnCounts + x, 1, memory_order_relaxed);
+}
+
+// Called whenever the ID at a position changes
+static void tsc_grid_indexChanged(tsc_grid *grid, int x, int y, tsc_id_t oldID, tsc_id_t newID) {
+    if(!tsc_grid_indicesValid(grid)) return;
+    grid->idPlane[x + y * grid->width] = newID;
+    if(tsc_indexedIDs == NULL) return;
+    uint64_t oldMask = tsc_indexedIDs[oldID];
+    uint64_t newMask = tsc_indexedIDs[newID];
+    uint64_t changed = oldMask ^ newMask;
+    while(changed != 0) {
+        int i = __builtin_ctzll(changed);
+        changed &= changed - 1;
+        if(newMask & ((uint64_t)1 << i)) {
+            tsc_grid_indexAdd(grid, grid->indices + i, x, y);
+        } else {
+            tsc_grid_indexRemove(grid, grid->indices + i, x, y);
+        }
+    }
+}
+
+static void tsc_grid_resetCell(tsc_grid *grid, int x, int y, size_t optSize) {
+#ifndef TSC_TURBO
+    size_t i = x + y * grid->width;
+    tsc_cell *cell = grid->cells + i;
+    cell->updated = false;
+    cell->lx = x;
+    cell->ly = y;
+    cell->rotData = tsc_cell_getRotation(cell);
+    memset(grid->optData + i * optSize, 0, optSize);
+#endif
+}
+
+static void tsc_grid_resetRow(tsc_grid_init_task_t *task) {
+    size_t optSize = tsc_optSize();
+    for(int x = 0; x < task->grid->width; x++) {
+        tsc_grid_resetCell(task->grid, x, task->y, optSize);
+    }
+}
+
+static void tsc_grid_resetDirtyRow(tsc_grid_init_task_t *task) {
+    tsc_grid *grid = task->grid;
+    int y = task->y;
+    size_t words = tsc_grid_rowWords(grid);
+    atomic_ullong *line = grid->dirty + y * words;
+    atomic_ullong *changedLine = grid->changed + y * words;
+    size_t optSize = tsc_optSize();
+    for(size_t w = 0; w < words; w++) {
+        unsigned long long bits = atomic_exchange_explicit(line + w, 0, memory_order_relaxed);
+        while(bits != 0) {
+            int x = w * 64 + __builtin_ctzll(bits);
+            bits &= bits - 1;
+            tsc_grid_resetCell(grid, x, y, optSize);
+        }
+        // Stamped with the tick that just ended
+        unsigned long long changed = atomic_exchange_explicit(changedLine + w, 0, memory_order_relaxed);
+        while(changed != 0) {
+            int x = w * 64 + __builtin_ctzll(changed);
+            changed &= changed - 1;
+            atomic_store_explicit(grid->rowStamps + y * grid->chunkwidth + (x >> grid->chunkshift), grid->epoch, memory_order_relaxed);
+            atomic_store_explicit(grid->columnStamps + x * grid->chunkheight + (y >> grid->chunkshift), grid->epoch, memory_order_relaxed);
+        }
+    }
+}
+
+// Runs a row task over the given rows, in parallel if it's worth it
+static void tsc_grid_forRows(tsc_grid *grid, void (*task)(tsc_grid_init_task_t *task), tsc_grid_init_task_t *rows, size_t rowc) {
+    if(grid->width * grid->height < 100000) {
+        for(size_t i = 0; i < rowc; i++) {
+            task(rows + i);
+        }
+    } else {
+        workers_waitForTasksFlat((worker_task_t *)task, rows, sizeof(tsc_grid_init_task_t), rowc);
+    }
+}
+
+static void tsc_grid_resetAll(tsc_grid *grid) {
+    tsc_grid_init_task_t *buffer = malloc(sizeof(tsc_grid_init_task_t) * grid->height);
+    for(int y = 0; y < grid->height; y++) {
+        buffer[y].grid = grid;
+        buffer[y].y = y;
+    }
+    tsc_grid_forRows(grid, tsc_grid_resetRow, buffer, grid->height);
+    free(buffer);
+}
+
+void tsc_grid_markUpdated(tsc_grid *grid, int x, int y) {
+    // Everything that writes to a cell ends up here, so this is where we catch the ones leaving the line
+    if(tsc_grid_isClaimed(grid) && !tsc_grid_onClaimedLine(x, y)) {
+        (*tsc_grid_conflicts)++;
+    }
+#ifndef TSC_TURBO
+    if(!tsc_grid_indicesValid(grid)) return;
+    if(x < 0 || y < 0 || x >= grid->width || y >= grid->height) return;
+    atomic_ullong *word = grid->dirty + y * tsc_grid_rowWords(grid) + x / 64;
+    unsigned long long bit = 1ULL << (x % 64);
+    if(atomic_load_explicit(word, memory_order_relaxed) & bit) return;
+    atomic_fetch_or_explicit(word, bit, memory_order_relaxed);
+    atomic_store_explicit(grid->dirtyRows + y, true, memory_order_relaxed);
+#endif
+}
+
+void tsc_grid_markDirty(tsc_grid *grid, int x, int y) {
+    tsc_grid_markUpdated(grid, x, y);
+#ifndef TSC_TURBO
+    if(!tsc_grid_indicesValid(grid)) return;
+    if(x < 0 || y < 0 || x >= grid->width || y >= grid->height) return;
+    atomic_ullong *word = grid->changed + y * tsc_grid_rowWords(grid) + x / 64;
+    unsigned long long bit = 1ULL << (x % 64);
+    if(atomic_load_explicit(word, memory_order_relaxed) & bit) return;
+    atomic_fetch_or_explicit(word, bit, memory_order_relaxed);
+#endif
+}
+
+// Whether nothing changed in the len cells starting at x, y going in dir, since the tick with the given epoch started.
+// Changes from this tick are still in the bitset, older ones only have stamps.
+static bool tsc_grid_lineUnchanged(tsc_grid *grid, int x, int y, char dir, int len, unsigned int epoch) {
+    int ex = tsc_grid_shiftX(x, dir, len - 1);
+    int ey = tsc_grid_shiftY(y, dir, len - 1);
+    int sx = x < ex ? x : ex;
+    int sy = y < ey ? y : ey;
+    if(ex < x) ex = x;
+    if(ey < y) ey = y;
+    // Outside the grid nothing ever changes
+    if(sx < 0) sx = 0;
+    if(sy < 0) sy = 0;
+    if(ex >= grid->width) ex = grid->width - 1;
+    if(ey >= grid->height) ey = grid->height - 1;
+    if(sx > ex || sy > ey) return true;
+
+    size_t words = tsc_grid_rowWords(grid);
+    if(dir % 2 == 0) {
+        for(int c = sx >> grid->chunkshift; c <= (ex >> grid->chunkshift); c++) {
+            if(atomic_load_explicit(grid->rowStamps + sy * grid->chunkwidth + c, memory_order_relaxed) >= epoch) return false;
+        }
+        atomic_ullong *line = grid->changed + sy * words;
+        for(int w = sx / 64; w <= ex / 64; w++) {
+            unsigned long long mask = ~0ULL;
+            if(w == sx / 64) mask &= ~0ULL << (sx % 64);
+            if(w == ex / 64 && ex % 64 != 63) mask &= (1ULL << (ex % 64 + 1)) - 1;
+            if(atomic_load_explicit(line + w, memory_order_relaxed) & mask) return false;
+        }
+    } else {
+        for(int c = sy >> grid->chunkshift; c <= (ey >> grid->chunkshift); c++) {
+            if(atomic_load_explicit(grid->columnStamps + sx * grid->chunkheight + c, memory_order_relaxed) >= epoch) return false;
+        }
+        unsigned long long bit = 1ULL << (sx % 64);
+        for(int cy = sy; cy <= ey; cy++) {
+            if(atomic_load_explicit(grid->changed + cy * words + sx / 64, memory_order_relaxed) & bit) return false;
+        }
+    }
+    return true;
+}
+
+// Packed as the length, the direction and the epoch it was blocked in. 0 means nothing, since epochs start at 1.
+void tsc_grid_setBlocked(tsc_grid *grid, int x, int y, char dir, int len) {
+#ifndef TSC_TURBO
+    if(!tsc_grid_indicesValid(grid)) return;
+    if(x < 0 || y < 0 || x >= grid->width || y >= grid->height) return;
+    if(len <= 0 || len >= (1 << 30)) return;
+    grid->blocked[x + y * grid->width] = ((uint64_t)len << 34) | ((uint64_t)(dir & 3) << 32) | grid->epoch;
+#endif
+}
+
+bool tsc_grid_isBlocked(tsc_grid *grid, int x, int y, char dir) {
+#ifndef TSC_TURBO
+    if(!tsc_grid_indicesValid(grid)) return false;
+    if(x < 0 || y < 0 || x >= grid->width || y >= grid->height) return false;
+    uint64_t entry = grid->blocked[x + y * grid->width];
+    if(entry == 0) return false;
+    if(((entry >> 32) & 3) != (uint64_t)(dir & 3)) return false;
+    int len = entry >> 34;
+    unsigned int epoch = entry & 0xFFFFFFFF;
+    return tsc_grid_lineUnchanged(grid, tsc_grid_shiftX(x, dir, -1), tsc_grid_shiftY(y, dir, -1), dir, len, epoch);
+#else
+    return false;
+#endif
+}
+
+void tsc_grid_resetDirty(tsc_grid *grid) {
+#ifndef TSC_TURBO
+    if(!tsc_grid_indicesValid(grid)) return;
+    tsc_grid_init_task_t *buffer = malloc(sizeof(tsc_grid_init_task_t) * grid->height);
+    size_t rowc = 0;
+    for(int y = 0; y < grid->height; y++) {
+        if(!atomic_load_explicit(grid->dirtyRows + y, memory_order_relaxed)) continue;
+        atomic_store_explicit(grid->dirtyRows + y, false, memory_order_relaxed);
+        buffer[rowc].grid = grid;
+        buffer[rowc].y = y;
+        rowc++;
+    }
+    tsc_grid_forRows(grid, tsc_grid_resetDirtyRow, buffer, rowc);
+    free(buffer);
+    grid->epoch++;
+#endif
+}
+
+void tsc_grid_syncIndices(tsc_grid *grid) {
+    if(tsc_grid_indicesValid(grid)) return;
+    tsc_grid_freeIndices(grid);
+    grid->indexGeneration = tsc_indexGeneration;
+
+    size_t len = grid->width * grid->height;
+    grid->idPlane = malloc(sizeof(tsc_id_t) * len);
+    for(size_t i = 0; i < len; i++) {
+        grid->idPlane[i] = grid->cells[i].id;
+    }
+
+    // We have no idea what changed, so everything gets reset
+    grid->dirty = calloc(tsc_grid_rowWords(grid) * grid->height, sizeof(atomic_ullong));
+    grid->dirtyRows = calloc(grid->height, sizeof(atomic_bool));
+    grid->changed = calloc(tsc_grid_rowWords(grid) * grid->height, sizeof(atomic_ullong));
+    grid->rowStamps = calloc(grid->chunkwidth * grid->height, sizeof(atomic_uint));
+    grid->columnStamps = calloc(grid->chunkheight * grid->width, sizeof(atomic_uint));
+    grid->epoch = 1;
+    // Mostly untouched, since only the cells which get blocked write to it
+    grid->blocked = calloc(len, sizeof(uint64_t));
+    tsc_grid_resetAll(grid);
+
+    if(tsc_indexCount == 0) return;
+
+    size_t rowWords = tsc_grid_rowWords(grid);
+    size_t columnWords = tsc_grid_columnWords(grid);
+    grid->indexc = tsc_indexCount;
+    grid->indices = malloc(sizeof(tsc_grid_index) * grid->indexc);
+    for(size_t i = 0; i < grid->indexc; i++) {
+        grid->indices[i].rows = calloc(rowWords * grid->height, sizeof(atomic_ullong));
+        grid->indices[i].columns = calloc(columnWords * grid->width, sizeof(atomic_ullong));
+        grid->indices[i].rowCounts = calloc(grid->height, sizeof(atomic_int));
+        grid->indices[i].columnCounts = calloc(grid->width, sizeof(atomic_int));
+    }
+
+    for(int y = 0; y < grid->height; y++) {
+        for(int x = 0; x < grid->width; x++) {
+            uint64_t mask = tsc_indexedIDs[grid->idPlane[x + y * grid->width]];
+            while(mask != 0) {
+                int i = __builtin_ctzll(mask);
+                mask &= mask - 1;
+                tsc_grid_indexAdd(grid, grid->indices + i, x, y);
+            }
+        }
+    }
+}
+
+bool tsc_grid_checkIndexedRow(tsc_grid *grid, size_t index, int y) {
+    if(y < 0 || y >= grid->height) return false;
+    return atomic_load_explicit(grid->indices[index].rowCounts + y, memory_order_relaxed) > 0;
+}
+
+bool tsc_grid_checkIndexedColumn(tsc_grid *grid, size_t index, int x) {
+    if(x < 0 || x >= grid->width) return false;
+    return atomic_load_explicit(grid->indices[index].columnCounts + x, memory_order_relaxed) > 0;
+}
+
+int tsc_grid_countIndexedRow(tsc_grid *grid, size_t index, int y) {
+    if(y < 0 || y >= grid->height) return 0;
+    return atomic_load_explicit(grid->indices[index].rowCounts + y, memory_order_relaxed);
+}
+
+int tsc_grid_countIndexedColumn(tsc_grid *grid, size_t index, int x) {
+    if(x < 0 || x >= grid->width) return 0;
+    return atomic_load_explicit(grid->indices[index].columnCounts + x, memory_order_relaxed);
+}
+
+// Scans a padded line of bits for the first set bit at or after i. The padding is never set, so len doesn't matter.
+static int tsc_grid_nextBit(atomic_ullong *line, size_t words, int i) {
+    if(i < 0) i = 0;
+    size_t w = i / 64;
+    if(w >= words) return -1;
+    unsigned long long bits = atomic_load_explicit(line + w, memory_order_relaxed) & (~0ULL << (i % 64));
+    while(bits == 0) {
+        w++;
+        if(w >= words) return -1;
+        bits = atomic_load_explicit(line + w, memory_order_relaxed);
+    }
+    return w * 64 + __builtin_ctzll(bits);
+}
+
+static int tsc_grid_prevBit(atomic_ullong *line, size_t words, int i) {
+    if(i < 0) return -1;
+    size_t w = i / 64;
+    if(w >= words) {
+        w = words - 1;
+        i = w * 64 + 63;
+    }
+    int bit = i % 64;
+    unsigned long long mask = bit == 63 ? ~0ULL : ((1ULL << (bit + 1)) - 1);
+    unsigned long long bits = atomic_load_explicit(line + w, memory_order_relaxed) & mask;
+    while(bits == 0) {
+        if(w == 0) return -1;
+        w--;
+        bits = atomic_load_explicit(line + w, memory_order_relaxed);
+    }
+    return w * 64 + 63 - __builtin_clzll(bits);
+}
+
+int tsc_grid_nextIndexedInRow(tsc_grid *grid, size_t index, int x, int y) {
+    if(y < 0 || y >= grid->height) return -1;
+    size_t words = tsc_grid_rowWords(grid);
+    return tsc_grid_nextBit(grid->indices[index].rows + y * words, words, x);
+}
+
+int tsc_grid_prevIndexedInRow(tsc_grid *grid, size_t index, int x, int y) {
+    if(y < 0 || y >= grid->height) return -1;
+    size_t words = tsc_grid_rowWords(grid);
+    return tsc_grid_prevBit(grid->indices[index].rows + y * words, words, x);
+}
+
+int tsc_grid_nextIndexedInColumn(tsc_grid *grid, size_t index, int x, int y) {
+    if(x < 0 || x >= grid->width) return -1;
+    size_t words = tsc_grid_columnWords(grid);
+    return tsc_grid_nextBit(grid->indices[index].columns + x * words, words, y);
+}
+
+int tsc_grid_prevIndexedInColumn(tsc_grid *grid, size_t index, int x, int y) {
+    if(x < 0 || x >= grid->width) return -1;
+    size_t words = tsc_grid_columnWords(grid);
+    return tsc_grid_prevBit(grid->indices[index].columns + x * words, words, y);
+}
+
+// tsc_cell_swap and friends have no idea where the cells are, so we check if they're in the current grid.
+// Other grids get rebuilt when switched to anyways.
+static bool tsc_grid_findCell(tsc_grid *grid, tsc_cell *cell, int *x, int *y) {
+    if(grid == NULL) return false;
+    if(!tsc_grid_indicesValid(grid)) return false;
+    tsc_cell *start = grid->cells;
+    tsc_cell *end = grid->cells + grid->width * grid->height;
+    if(cell < start || cell >= end) return false;
+    size_t i = cell - start;
+    *x = i % grid->width;
+    *y = i / grid->width;
+    return true;
+}
+
+void tsc_grid_trackSwap(tsc_cell *a, tsc_cell *b) {
+    tsc_grid *grid = currentGrid;
+    int x, y;
+    // a now has what b used to have and vice versa
+    if(tsc_grid_findCell(grid, a, &x, &y)) {
+        if(a->id != b->id) tsc_grid_indexChanged(grid, x, y, b->id, a->id);
+        tsc_grid_markDirty(grid, x, y);
+    }
+    if(tsc_grid_findCell(grid, b, &x, &y)) {
+        if(a->id != b->id) tsc_grid_indexChanged(grid, x, y, a->id, b->id);
+        tsc_grid_markDirty(grid, x, y);
+    }
+}
+
+void tsc_grid_trackCell(tsc_cell *cell) {
+    int x, y;
+    if(tsc_grid_findCell(currentGrid, cell, &x, &y)) {
+        tsc_grid_markDirty(currentGrid, x, y);
+    }
+}
+
+static _Thread_local int tsc_grid_pushLength = 0;
+
+// How many plain cells are in a row starting at x, y going in dir
+static int tsc_grid_plainRun(tsc_grid *grid, int x, int y, char dir) {
+    int max;
+    ptrdiff_t stride;
+    if(dir == 0) {
+        max = grid->width - x;
+        stride = 1;
+    } else if(dir == 1) {
+        max = grid->height - y;
+        stride = grid->width;
+    } else if(dir == 2) {
+        max = x + 1;
+        stride = -1;
+    } else {
+        max = y + 1;
+        stride = -(ptrdiff_t)grid->width;
+    }
+    tsc_id_t *id = grid->idPlane + x + y * grid->width;
+    int run = 0;
+    tsc_id_t empty = builtin.empty;
+    // Air ends the push, so it never counts even though it doesn't do anything
+    while(run < max && *id != empty && (tsc_cellCapabilities[*id] & TSC_CAP_PLAIN) == TSC_CAP_PLAIN) {
+        run++;
+        id += stride;
+    }
+    return run;
+}
+
+int tsc_grid_failedPushLength() {
+    return tsc_grid_pushLength;
 }
 
 int tsc_grid_push(tsc_grid *grid, int x, int y, char dir, double force, tsc_cell *replacement) {
+    tsc_grid_checkLine(grid, x, y, dir);
     // Beautiful hack
     tsc_cell empty = tsc_cell_create(builtin.empty, 0);
     if(replacement == NULL) {
@@ -411,21 +1047,38 @@ int tsc_grid_push(tsc_grid *grid, int x, int y, char dir, double force, tsc_cell
     int cx = x;
     int cy = y;
     tsc_cell replacecell = tsc_cell_clone(replacement);
+    bool usePlane = tsc_grid_indicesValid(grid);
     while(true) {
+        // Only the plane gets read until something interesting shows up.
+        // The replacement can't be acid either, or it could dissolve the first one.
+        if(usePlane && force > 0 && (tsc_cellCapabilities[replacement->id] & TSC_CAP_NOT_ACID)) {
+            int run = tsc_grid_plainRun(grid, cx, cy, dir);
+            if(run > 0) {
+                amount += run;
+                cx = tsc_grid_shiftX(cx, dir, run);
+                cy = tsc_grid_shiftY(cy, dir, run);
+                replacement = tsc_grid_get(grid, tsc_grid_shiftX(cx, dir, -1), tsc_grid_shiftY(cy, dir, -1));
+            }
+        }
         tsc_cell *cell = tsc_grid_get(grid, cx, cy);
-        if(cell == NULL) return 0;
+        if(cell == NULL) {
+            tsc_grid_pushLength = amount;
+            return 0;
+        }
         if(cell->id == builtin.empty) {
             amount++;
             break;
         }
-        force += tsc_cell_getBias(grid, cell, cx, cy, dir, "push", force);
-        if(force <= 0) return 0;
-        if(!tsc_cell_canMove(grid, cell, cx, cy, dir, "push", force)) return 0;
-        if(tsc_cell_isAcid(grid, replacement, dir, "push", force, cell, cx, cy)) {
+        force += tsc_cell_getBiasWith(grid, cell, cx, cy, dir, builtin.forces.push, force);
+        if(force <= 0 || !tsc_cell_canMoveWith(grid, cell, cx, cy, dir, builtin.forces.push, force)) {
+            tsc_grid_pushLength = amount + 1;
+            return 0;
+        }
+        if(tsc_cell_isAcidWith(grid, replacement, dir, builtin.forces.push, force, cell, cx, cy)) {
             mode = 1;
             break;
         }
-        if(tsc_cell_isTrash(grid, cell, cx, cy, dir, "push", force, replacement)) {
+        if(tsc_cell_isTrashWith(grid, cell, cx, cy, dir, builtin.forces.push, force, replacement)) {
             mode = 2;
             break;
         }
@@ -435,19 +1088,26 @@ int tsc_grid_push(tsc_grid *grid, int x, int y, char dir, double force, tsc_cell
         amount++;
     }
 
-    // Move using tsc_cell_swap
+    // Move by swapping, we know where everything is so the indices are updated here instead of in tsc_cell_swap
     for(int i = 0; i < amount; i++) {
-        tsc_cell_swap(tsc_grid_get(grid, x, y), &replacecell);
+        tsc_cell *cell = tsc_grid_get(grid, x, y);
+        tsc_cell old = *cell;
+        *cell = replacecell;
+        replacecell = old;
+        if(old.id != cell->id) {
+            tsc_grid_indexChanged(grid, x, y, old.id, cell->id);
+        }
+        tsc_grid_markDirty(grid, x, y);
         tsc_grid_enableChunk(grid, x, y);
         x = tsc_grid_frontX(x, dir);
         y = tsc_grid_frontY(y, dir);
     }
 
     if(mode == 1) {
-        tsc_cell_onAcid(grid, &replacecell, dir, "push", force, tsc_grid_get(grid, x, y), x, y);
+        tsc_cell_onAcidWith(grid, &replacecell, dir, builtin.forces.push, force, tsc_grid_get(grid, x, y), x, y);
     }
     if(mode == 2) {
-        tsc_cell_onTrash(grid, tsc_grid_get(grid, x, y), x, y, dir, "push", force, &replacecell);     
+        tsc_cell_onTrashWith(grid, tsc_grid_get(grid, x, y), x, y, dir, builtin.forces.push, force, &replacecell);     
     }
     
     tsc_cell_destroy(replacecell);
@@ -459,6 +1119,7 @@ int tsc_grid_push(tsc_grid *grid, int x, int y, char dir, double force, tsc_cell
 }
 
 int tsc_grid_pull(tsc_grid *grid, int x, int y, char dir, double force, tsc_cell *replacement) {
+    tsc_grid_checkLine(grid, x, y, dir);
     int m = 0;
 
     while(true) {
@@ -471,21 +1132,21 @@ int tsc_grid_pull(tsc_grid *grid, int x, int y, char dir, double force, tsc_cell
             return m;
         }
 
-        if(!tsc_cell_canMove(grid, current, x, y, dir, "pull", force)) {
+        if(!tsc_cell_canMoveWith(grid, current, x, y, dir, builtin.forces.pull, force)) {
             return m;
         }
 
-        force += tsc_cell_getBias(grid, current, x, y, dir, "pull", force);
+        force += tsc_cell_getBiasWith(grid, current, x, y, dir, builtin.forces.pull, force);
 
         int fx = tsc_grid_frontX(x, dir);
         int fy = tsc_grid_frontY(y, dir);
         tsc_cell *front = tsc_grid_get(grid, fx, fy);
         if(front == NULL) return m;
 
-        if(tsc_cell_isTrash(grid, front, fx, fy, dir, "pull", force, current)) {
-           tsc_cell_onTrash(grid, front, fx, fy, dir, "pull", force, current);
-        } else if(tsc_cell_isAcid(grid, current, dir, "pull", force, front, fx, fy)) {
-            tsc_cell_onAcid(grid, current, dir, "pull", force, front, fx, fy);
+        if(tsc_cell_isTrashWith(grid, front, fx, fy, dir, builtin.forces.pull, force, current)) {
+           tsc_cell_onTrashWith(grid, front, fx, fy, dir, builtin.forces.pull, force, current);
+        } else if(tsc_cell_isAcidWith(grid, current, dir, builtin.forces.pull, force, front, fx, fy)) {
+            tsc_cell_onAcidWith(grid, current, dir, builtin.forces.pull, force, front, fx, fy);
         } else if(front->id == builtin.empty) {
             tsc_grid_set(grid, fx, fy, current);
         } else {
@@ -4,6 +4,7 @@
 #include <stdatomic.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct tsc_cellreg {
     const char **keys;
@@ -42,11 +43,29 @@ typedef struct tsc_cell {
 #endif
 } tsc_cell;
 
+// The chunk size new grids get (existing ones keep theirs until resized).
+// Has to be a power of 2, anything else gets rounded up.
+#ifndef TSC_DEFAULT_CHUNK_SIZE
+#define TSC_DEFAULT_CHUNK_SIZE 32
+#endif
 extern size_t tsc_gridChunkSize;
 typedef struct tsc_grid tsc_grid;
 
 #define TSC_FLAGS_PLACEABLE 1
 
+// One cell which is getting updated, as handed to updateBatch
+typedef struct tsc_cell_update_t {
+    tsc_cell *cell;
+    // The ID it had when it got queued
+    tsc_id_t id;
+    // Whether it goes through updated (neighbour updates don't)
+    bool tracked;
+    int x;
+    int y;
+    int ux;
+    int uy;
+} tsc_cell_update_t;
+
 // Stores function pointers and payload for everything we might need from a modded cell.
 // Can be used in place of ID comparison (technically) but it's not much of a benefit.
 typedef struct tsc_celltable {
@@ -61,12 +80,40 @@ typedef struct tsc_celltable {
     void (*onTrash)(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force, tsc_cell *eating, void *payload);
     int (*isAcid)(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy, void *payload);
     void (*onAcid)(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy, void *payload);
+    // Optional, and used instead of update if set. Gets runs of cells from the same line of a subtick, in the order update would have been
+    // called on them. Earlier ones can move or replace later ones, so only update the ones tsc_cell_startUpdate says yes to.
+    void (*updateBatch)(tsc_cell_update_t *updates, size_t len, void *payload);
 } tsc_celltable;
 
 tsc_celltable *tsc_cell_newTable(tsc_id_t id);
 tsc_celltable *tsc_cell_getTable(tsc_cell *cell);
+// For updateBatch. False if the cell was already updated or isn't the one which got queued anymore, otherwise marks it updated.
+bool tsc_cell_startUpdate(tsc_cell_update_t *update);
 size_t tsc_cell_getTableFlags(tsc_cell *cell);
 
+// What every ID does without needing to ask its table, so hot paths can skip checking the callbacks one by one.
+// Worked out from the tables (and what the builtins do) before every tick, since mods fill in their tables whenever.
+// canMove is always true
+#define TSC_CAP_MOVABLE 1
+// getBias is always 0
+#define TSC_CAP_NO_BIAS 2
+// isTrash is always false
+#define TSC_CAP_NOT_TRASH 4
+// isAcid is always false
+#define TSC_CAP_NOT_ACID 8
+// canGenerate is always true
+#define TSC_CAP_CAN_GENERATE 16
+// None of the callbacks above are set, so what they return only depends on the ID, the rotation and the force
+#define TSC_CAP_NO_HOOKS 32
+// Pushes and pulls go right through these
+#define TSC_CAP_PLAIN (TSC_CAP_MOVABLE | TSC_CAP_NO_BIAS | TSC_CAP_NOT_TRASH | TSC_CAP_NOT_ACID)
+
+// hideapi
+extern unsigned char tsc_cellCapabilities[TSC_ID_COUNT];
+void tsc_cell_refreshCapabilities();
+// hideapi
+unsigned char tsc_cell_getCapabilities(tsc_id_t id);
+
 typedef struct tsc_texture_id_pool_t {
     const char *icon;
     const char *copy;
@@ -89,6 +136,18 @@ typedef struct tsc_optimization_id_pool_t {
     size_t gens[4];
 } tsc_optimization_id_pool_t;
 
+// Force types are registered once and passed around as small integers, so the interaction functions compare numbers instead of strings.
+// Cell tables still get the name, which is interned.
+typedef size_t tsc_force_t;
+#define TSC_MAX_FORCE_TYPES 256
+// What names which were never registered turn into
+#define TSC_UNKNOWN_FORCE TSC_MAX_FORCE_TYPES
+
+typedef struct tsc_force_id_pool_t {
+    tsc_force_t push;
+    tsc_force_t pull;
+} tsc_force_id_pool_t;
+
 typedef struct tsc_setting_id_pool_t {
     const char *vsync;
     const char *fullscreen;
@@ -121,6 +180,7 @@ typedef struct tsc_id_pool_t {
     tsc_audio_id_pool_t audio;
     tsc_optimization_id_pool_t optimizations;
     tsc_setting_id_pool_t settings;
+    tsc_force_id_pool_t forces;
 } tsc_cell_id_pool_t;
 
 extern tsc_cell_id_pool_t builtin;
@@ -138,6 +198,15 @@ char tsc_cell_getRotation(tsc_cell *cell);
 void tsc_cell_setRotationData(tsc_cell *cell, signed char rot, signed char addedRot);
 signed char tsc_cell_getAddedRotation(tsc_cell *cell);
 
+// A set of positions, stored as a bitset once row-major and once column-major (each row or column padded to 64 bits),
+// along with how many positions are in each row and column.
+typedef struct tsc_grid_index {
+    atomic_ullong *rows;
+    atomic_ullong *columns;
+    atomic_int *rowCounts;
+    atomic_int *columnCounts;
+} tsc_grid_index;
+
 typedef struct tsc_grid {
     tsc_cell *cells;
     tsc_cell *bgs;
@@ -146,10 +215,35 @@ typedef struct tsc_grid {
     const char *title;
     const char *desc;
     size_t refc;
-    bool *chunkdata;
+    // One bit per chunk, each row of chunks is padded to chunkwords words.
+    atomic_ullong *chunkdata;
     int chunkwidth;
     int chunkheight;
     char *optData;
+    tsc_grid_index *indices;
+    size_t indexc;
+    size_t indexGeneration;
+    // The ID of every cell, kept in sync along with the indices. Scans which only care about IDs should use this
+    // instead of dragging entire cells through the cache. Only valid while ticking.
+    tsc_id_t *idPlane;
+    // Positions changed this tick, see tsc_grid_markDirty
+    atomic_ullong *dirty;
+    atomic_bool *dirtyRows;
+    // The dirty positions whose cell actually changed, not just updated or got optimized
+    atomic_ullong *changed;
+    // The last tick something changed in every chunk-wide piece of every row, and every chunk-tall piece of every column
+    atomic_uint *rowStamps;
+    atomic_uint *columnStamps;
+    // Goes up by 1 every tick
+    unsigned int epoch;
+    // See tsc_grid_setBlocked
+    uint64_t *blocked;
+    size_t chunkwords;
+    // Chunks are 1 << chunkshift cells wide
+    int chunkshift;
+    // How many chunks are enabled in every row and column of chunks
+    atomic_int *chunkRowCounts;
+    atomic_int *chunkColumnCounts;
 } tsc_grid;
 
 typedef struct tsc_gridStorage {
@@ -161,11 +255,25 @@ typedef struct tsc_gridStorage {
 extern tsc_grid *currentGrid;
 extern int tsc_maxSliceSize;
 
+// At most this many trashed cells are kept per thread, and in total per tick
 #define TSC_MAX_TRASHED 131072
-extern tsc_cell tsc_trashedCellBuffer[TSC_MAX_TRASHED];
-extern atomic_size_t tsc_trashedCellCount;
+
+typedef struct tsc_trashed_cell_t {
+    tsc_cell cell;
+    int x;
+    int y;
+} tsc_trashed_cell_t;
 
 void tsc_trashCell(tsc_cell *cell, int x, int y);
+// The cells trashed during the last finished tick, for drawing them fading out.
+// The array stays valid until tsc_releaseTrashedCells, however many ticks finish in between. Only one thread may read them at a time.
+tsc_trashed_cell_t *tsc_getTrashedCells(size_t *len);
+void tsc_releaseTrashedCells();
+// Only call these while nothing is ticking
+void tsc_clearTrashedCells();
+// hideapi
+void tsc_publishTrashedCells();
+// hideapi
 
 // hideapi
 extern tsc_gridStorage *gridStorage;
@@ -180,6 +288,9 @@ void tsc_switchGrid(tsc_grid *grid);
 void tsc_copyGrid(tsc_grid *dest, tsc_grid *src);
 void tsc_clearGrid(tsc_grid *grid, int width, int height);
 void tsc_nukeGrids();
+// Returns how many positions have a different cell or background, and puts the first one (left to right, top to bottom) in x and y.
+// Grids of different sizes are different everywhere.
+size_t tsc_diffGrids(tsc_grid *a, tsc_grid *b, int *x, int *y);
 
 size_t tsc_allocOptimization(const char *id);
 size_t tsc_findOptimization(const char *trueID);
@@ -202,11 +313,64 @@ void tsc_grid_disableChunk(tsc_grid *grid, int x, int y);
 bool tsc_grid_checkChunk(tsc_grid *grid, int x, int y);
 bool tsc_grid_checkRow(tsc_grid *grid, int y);
 bool tsc_grid_checkColumn(tsc_grid *grid, int x);
-int tsc_grid_chunkOff(int x, int off);
+// Disables every chunk that has no cells or backgrounds in it anymore. The tick loop does this before every tick.
+void tsc_grid_sweepChunks(tsc_grid *grid);
+// Start of the chunk off chunks away from the one x is in
+int tsc_grid_chunkOff(tsc_grid *grid, int x, int off);
 bool tsc_grid_checkOptimization(tsc_grid *grid, int x, int y, size_t optimization);
 void tsc_grid_setOptimization(tsc_grid *grid, int x, int y, size_t optimization, bool enabled);
 
+// Sparse position indices, so subticks only visit the cells they care about instead of the entire grid.
+// Index N holds every position whose cell ID was added to it. They are kept up to date by tsc_grid_set, tsc_grid_push
+// and tsc_cell_swap (for the current grid), and are rebuilt (along with idPlane) by tsc_grid_syncIndices when the grid was replaced wholesale
+// (loading, resizing, switching) or new IDs were indexed. Anything writing to cells directly must call tsc_grid_invalidateIndices.
+#define TSC_MAX_INDICES 64
+#define TSC_NO_INDEX TSC_MAX_INDICES
+
+// Returns TSC_NO_INDEX if we ran out
+size_t tsc_grid_newIndex();
+void tsc_grid_addIndexedID(size_t index, tsc_id_t id);
+void tsc_grid_invalidateIndices(tsc_grid *grid);
+void tsc_grid_syncIndices(tsc_grid *grid);
+// The rest assume the indices are in sync
+bool tsc_grid_checkIndexedRow(tsc_grid *grid, size_t index, int y);
+bool tsc_grid_checkIndexedColumn(tsc_grid *grid, size_t index, int x);
+// How many indexed positions are in the row or column
+int tsc_grid_countIndexedRow(tsc_grid *grid, size_t index, int y);
+int tsc_grid_countIndexedColumn(tsc_grid *grid, size_t index, int x);
+// Closest indexed position at or after (next) / at or before (prev) the given one in the row or column. -1 if there is none.
+int tsc_grid_nextIndexedInRow(tsc_grid *grid, size_t index, int x, int y);
+int tsc_grid_prevIndexedInRow(tsc_grid *grid, size_t index, int x, int y);
+int tsc_grid_nextIndexedInColumn(tsc_grid *grid, size_t index, int x, int y);
+int tsc_grid_prevIndexedInColumn(tsc_grid *grid, size_t index, int x, int y);
+// Instead of resetting every cell before every tick, only positions which changed are reset.
+// Setting, pushing, swapping, rotating, optimizations and updates by subticks do this for you, but if you change updated, lx, ly
+// or rotData through a pointer yourself, mark it dirty, or else it'll stay that way next tick.
+void tsc_grid_markDirty(tsc_grid *grid, int x, int y);
+// Clears updated, resets lx/ly and added rotation and zeroes the optimizations of every dirty position. Done before every tick.
+void tsc_grid_resetDirty(tsc_grid *grid);
+// hideapi
+void tsc_grid_trackSwap(tsc_cell *a, tsc_cell *b);
+void tsc_grid_trackCell(tsc_cell *cell);
+// Like tsc_grid_markDirty, but for when only updated or the optimizations changed
+void tsc_grid_markUpdated(tsc_grid *grid, int x, int y);
+// hideapi
+// Cells which keep failing at the same thing can remember it, instead of trying again every tick.
+// This says the cell at x, y failed in dir, and that it only depends on the len cells starting right behind it going in dir.
+// It stays blocked until one of those changes (or anything near them, in the same chunk-sized piece of the line).
+// Only use it if the result depends on nothing but those cells, so no callbacks which could look at anything else.
+void tsc_grid_setBlocked(tsc_grid *grid, int x, int y, char dir, int len);
+bool tsc_grid_isBlocked(tsc_grid *grid, int x, int y, char dir);
+
+// Registering the same name twice gives the same ID. Returns TSC_UNKNOWN_FORCE if there are too many.
+tsc_force_t tsc_registerForceType(const char *name);
+// TSC_UNKNOWN_FORCE if it was never registered
+tsc_force_t tsc_findForceType(const char *name);
+// NULL for TSC_UNKNOWN_FORCE
+const char *tsc_forceTypeName(tsc_force_t forceType);
+
 // Cell interactions
+// The ones taking a string are for compatibility, they look up the force type every time.
 
 int tsc_cell_canMove(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force);
 float tsc_cell_getBias(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force);
@@ -215,10 +379,27 @@ int tsc_cell_isTrash(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, con
 void tsc_cell_onTrash(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, const char *forceType, double force, tsc_cell *eating);
 int tsc_cell_isAcid(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy);
 void tsc_cell_onAcid(tsc_grid *grid, tsc_cell *cell, char dir, const char *forceType, double force, tsc_cell *dissolving, int dx, int dy);
+int tsc_cell_canMoveWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force);
+float tsc_cell_getBiasWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force);
+int tsc_cell_isTrashWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force, tsc_cell *eating);
+void tsc_cell_onTrashWith(tsc_grid *grid, tsc_cell *cell, int x, int y, char dir, tsc_force_t forceType, double force, tsc_cell *eating);
+int tsc_cell_isAcidWith(tsc_grid *grid, tsc_cell *cell, char dir, tsc_force_t forceType, double force, tsc_cell *dissolving, int dx, int dy);
+void tsc_cell_onAcidWith(tsc_grid *grid, tsc_cell *cell, char dir, tsc_force_t forceType, double force, tsc_cell *dissolving, int dx, int dy);
 char *tsc_cell_signal(tsc_cell *cell, int x, int y, const char *protocol, const char *data, tsc_cell *sender, int sx, int sy);
 
+// Parallel subticks give every task a line (a row or a column), and whatever a cell does while it's updated should stay on that line,
+// since other threads are busy with the ones around it. Pushes, pulls and writes which leave it are counted as conflicts,
+// and a subtick which had any goes back to running serially, see tsc_subtick_t.
+// hideapi
+// axis is 0 for rows and 1 for columns. Conflicts get added to *conflicts, which must only be used by this thread until it's released.
+void tsc_grid_claimLine(size_t *conflicts, char axis, int line);
+void tsc_grid_releaseLine();
+// hideapi
+
 // Returns how many cells were pushed.
+// If it failed, tsc_grid_failedPushLength says how many cells it looked at, including the one that stopped it.
 int tsc_grid_push(tsc_grid *grid, int x, int y, char dir, double force, tsc_cell *replacement);
+int tsc_grid_failedPushLength();
 // Returns how many cells were pulled.
 int tsc_grid_pull(tsc_grid *grid, int x, int y, char dir, double force, tsc_cell *replacement);
 // Returns how many cells were grabbed.
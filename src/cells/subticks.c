@@ -11,17 +11,9 @@
 
 tsc_subtick_manager_t subticks = {NULL, 0};
 
-static tsc_updateinfo_t *subticks_updateBuffer = NULL;
-static size_t subticks_updateLength = 0;
-
-static tsc_updateinfo_t *subticks_getBuffer(size_t amount) {
-    if(subticks_updateLength < amount) {
-        subticks_updateBuffer = realloc(subticks_updateBuffer, sizeof(tsc_updateinfo_t) * amount);
-        subticks_updateLength = amount;
-        return subticks_updateBuffer;
-    }
-
-    return subticks_updateBuffer;
+// Every parallel subtick gets its own buffer, since subticks which commute can run at the same time
+static tsc_updateinfo_t *subticks_newBuffer(size_t amount) {
+    return malloc(sizeof(tsc_updateinfo_t) * amount);
 }
 
 static void tsc_subtick_swap(tsc_subtick_t *a, tsc_subtick_t *b) {
@@ -81,6 +73,11 @@ static void tsc_subtick_sort(int low, int high) {
 }
 
 tsc_subtick_t *tsc_subtick_add(tsc_subtick_t subtick) {
+    // Whatever was passed in, the bits come from ids
+    subtick.idBits = calloc(TSC_ID_COUNT / 64, sizeof(uint64_t));
+    for(size_t i = 0; i < subtick.idc; i++) {
+        subtick.idBits[subtick.ids[i] / 64] |= (uint64_t)1 << (subtick.ids[i] % 64);
+    }
     size_t idx = subticks.subc++;
     subticks.subs = realloc(subticks.subs, sizeof(tsc_subtick_t) * subticks.subc);
     subticks.subs[idx] = subtick;
@@ -93,6 +90,8 @@ void tsc_subtick_addCell(tsc_subtick_t *subtick, tsc_id_t cell) {
     size_t idx = subtick->idc++;
     subtick->ids = realloc(subtick->ids, subtick->idc * sizeof(tsc_id_t));
     subtick->ids[idx] = cell;
+    subtick->idBits[cell / 64] |= (uint64_t)1 << (cell % 64);
+    tsc_grid_addIndexedID(subtick->cellIndex, cell);
 }
 
 // Names must be interned because I said so
@@ -114,6 +113,11 @@ static tsc_subtick_t tsc_subtick_createNew(const char *name, double priority, ch
     subtick.name = name;
     subtick.ids = NULL;
     subtick.idc = 0;
+    subtick.cellIndex = tsc_grid_newIndex();
+    subtick.commutes = NULL;
+    subtick.commutec = 0;
+    subtick.conflicts = 0;
+    subtick.idBits = NULL;
     subtick.mode = TSC_SUBMODE_TICKED;
     return subtick;
 }
@@ -152,175 +156,380 @@ tsc_subtick_t *tsc_subtick_addCustom(const char *name, double priority, char spa
     return tsc_subtick_add(subtick);
 }
 
+static void tsc_subtick_addCommute(tsc_subtick_t *subtick, const char *other) {
+    size_t idx = subtick->commutec++;
+    subtick->commutes = realloc(subtick->commutes, sizeof(const char *) * subtick->commutec);
+    subtick->commutes[idx] = other;
+}
+
+void tsc_subtick_commute(tsc_subtick_t *a, tsc_subtick_t *b) {
+    if(a == b) return;
+    tsc_subtick_addCommute(a, b->name);
+    tsc_subtick_addCommute(b, a->name);
+}
+
+static bool tsc_subtick_commutesWith(tsc_subtick_t *a, tsc_subtick_t *b) {
+    for(size_t i = 0; i < a->commutec; i++) {
+        if(a->commutes[i] == b->name) return true;
+    }
+    return false;
+}
+
+static bool tsc_subtick_has(tsc_subtick_t *subtick, tsc_id_t id) {
+    return (subtick->idBits[id / 64] >> (id % 64)) & 1;
+}
+
+// Reads the ID plane, so it doesn't pull in the entire cell
+static bool tsc_subtick_hasAt(tsc_subtick_t *subtick, int x, int y) {
+    if(x < 0 || y < 0 || x >= currentGrid->width || y >= currentGrid->height) return false;
+    return tsc_subtick_has(subtick, currentGrid->idPlane[x + y * currentGrid->width]);
+}
+
+// These use the subtick's position index. If it doesn't have one (too many subticks), they fall back to walking the chunks.
+
+static bool tsc_subtick_checkRow(tsc_subtick_t *subtick, int y) {
+    if(subtick->cellIndex == TSC_NO_INDEX) return tsc_grid_checkRow(currentGrid, y);
+    return tsc_grid_checkIndexedRow(currentGrid, subtick->cellIndex, y);
+}
+
+static bool tsc_subtick_checkColumn(tsc_subtick_t *subtick, int x) {
+    if(subtick->cellIndex == TSC_NO_INDEX) return tsc_grid_checkColumn(currentGrid, x);
+    return tsc_grid_checkIndexedColumn(currentGrid, subtick->cellIndex, x);
+}
+
+static int tsc_subtick_nextInRow(tsc_subtick_t *subtick, int x, int y) {
+    if(subtick->cellIndex != TSC_NO_INDEX) return tsc_grid_nextIndexedInRow(currentGrid, subtick->cellIndex, x, y);
+    for(; x < currentGrid->width; x++) {
+        if(!tsc_grid_checkChunk(currentGrid, x, y)) {
+            x = tsc_grid_chunkOff(currentGrid, x, +1) - 1;
+            continue;
+        }
+        if(tsc_subtick_hasAt(subtick, x, y)) return x;
+    }
+    return -1;
+}
+
+static int tsc_subtick_prevInRow(tsc_subtick_t *subtick, int x, int y) {
+    if(subtick->cellIndex != TSC_NO_INDEX) return tsc_grid_prevIndexedInRow(currentGrid, subtick->cellIndex, x, y);
+    for(; x >= 0; x--) {
+        if(!tsc_grid_checkChunk(currentGrid, x, y)) {
+            x = tsc_grid_chunkOff(currentGrid, x, 0);
+            continue;
+        }
+        if(tsc_subtick_hasAt(subtick, x, y)) return x;
+    }
+    return -1;
+}
+
+static int tsc_subtick_nextInColumn(tsc_subtick_t *subtick, int x, int y) {
+    if(subtick->cellIndex != TSC_NO_INDEX) return tsc_grid_nextIndexedInColumn(currentGrid, subtick->cellIndex, x, y);
+    for(; y < currentGrid->height; y++) {
+        if(!tsc_grid_checkChunk(currentGrid, x, y)) {
+            y = tsc_grid_chunkOff(currentGrid, y, +1) - 1;
+            continue;
+        }
+        if(tsc_subtick_hasAt(subtick, x, y)) return y;
+    }
+    return -1;
+}
+
+static int tsc_subtick_prevInColumn(tsc_subtick_t *subtick, int x, int y) {
+    if(subtick->cellIndex != TSC_NO_INDEX) return tsc_grid_prevIndexedInColumn(currentGrid, subtick->cellIndex, x, y);
+    for(; y >= 0; y--) {
+        if(!tsc_grid_checkChunk(currentGrid, x, y)) {
+            y = tsc_grid_chunkOff(currentGrid, y, 0);
+            continue;
+        }
+        if(tsc_subtick_hasAt(subtick, x, y)) return y;
+    }
+    return -1;
+}
+
+// Runs of cells whose table has an updateBatch wait here until the line is done or another kind of cell comes up.
+// Every thread has its own, since workers do lines at the same time.
+static _Thread_local tsc_celltable *tsc_subtick_batchTable = NULL;
+static _Thread_local tsc_cell_update_t *tsc_subtick_batch = NULL;
+static _Thread_local size_t tsc_subtick_batchLen = 0;
+static _Thread_local size_t tsc_subtick_batchCap = 0;
+
+// Must be called at the end of every line, before anything else gets to see the grid
+static void tsc_subtick_flushBatch() {
+    if(tsc_subtick_batchLen == 0) return;
+    tsc_celltable *table = tsc_subtick_batchTable;
+    size_t len = tsc_subtick_batchLen;
+    tsc_subtick_batchTable = NULL;
+    tsc_subtick_batchLen = 0;
+    table->updateBatch(tsc_subtick_batch, len, table->payload);
+}
+
+static bool tsc_subtick_canUpdate(tsc_celltable *table) {
+    return table->update != NULL || table->updateBatch != NULL;
+}
+
+// tracked is for updates which go through updated, which neighbour updates don't.
+// Queued ones only get marked once they actually run, see tsc_cell_startUpdate.
+static void tsc_subtick_callUpdate(tsc_celltable *table, tsc_cell *cell, int x, int y, int ux, int uy, bool tracked) {
+    if(table->updateBatch == NULL) {
+        // Whatever was queued came first
+        tsc_subtick_flushBatch();
+        #ifndef TSC_TURBO
+        if(tracked) {
+            cell->updated = true;
+            tsc_grid_markUpdated(currentGrid, x, y);
+        }
+        #endif
+        table->update(cell, x, y, ux, uy, table->payload);
+        return;
+    }
+    if(table != tsc_subtick_batchTable) {
+        tsc_subtick_flushBatch();
+        tsc_subtick_batchTable = table;
+    }
+    if(tsc_subtick_batchLen == tsc_subtick_batchCap) {
+        tsc_subtick_batchCap = tsc_subtick_batchCap == 0 ? 64 : tsc_subtick_batchCap * 2;
+        tsc_subtick_batch = realloc(tsc_subtick_batch, sizeof(tsc_cell_update_t) * tsc_subtick_batchCap);
+    }
+    tsc_cell_update_t *update = tsc_subtick_batch + tsc_subtick_batchLen++;
+    update->cell = cell;
+    update->id = cell->id;
+    update->tracked = tracked;
+    update->x = x;
+    update->y = y;
+    update->ux = ux;
+    update->uy = uy;
+}
+
+// Where the cell being updated is, relative to the position it updates, in the order neighbour subticks go through them
+static const int tsc_subtick_neighbourOff[] = {
+    -1, 0,
+    1, 0,
+    0, -1,
+    0, 1
+};
+#define TSC_SUBTICK_NEIGHBOURS 4
+
+// Whether row y has any cells of the subtick next to it
+static bool tsc_subtick_nearRow(tsc_subtick_t *subtick, int y) {
+    return tsc_subtick_checkRow(subtick, y - 1) || tsc_subtick_checkRow(subtick, y) || tsc_subtick_checkRow(subtick, y + 1);
+}
+
+// Neighbour subticks are driven from their own cells instead of checking the neighbours of every position.
+// This is the first position at or after x in row y whose neighbour at offset i is in the subtick, or -1.
+static int tsc_subtick_nextNeighbour(tsc_subtick_t *subtick, int i, int x, int y) {
+    int dx = tsc_subtick_neighbourOff[i*2];
+    int dy = tsc_subtick_neighbourOff[i*2+1];
+    int sx = x + dx;
+    if(sx < 0) sx = 0;
+    sx = tsc_subtick_nextInRow(subtick, sx, y + dy);
+    if(sx < 0) return -1;
+    int tx = sx - dx;
+    if(tx >= currentGrid->width) return -1;
+    return tx;
+}
+
+static void tsc_subtick_updateNeighbour(int i, int x, int y) {
+    int cx = x + tsc_subtick_neighbourOff[i*2];
+    int cy = y + tsc_subtick_neighbourOff[i*2+1];
+    tsc_cell *cell = tsc_grid_get(currentGrid, cx, cy);
+    tsc_celltable *table = tsc_cell_getTable(cell);
+    if(table == NULL) return;
+    if(!tsc_subtick_canUpdate(table)) return;
+    tsc_subtick_callUpdate(table, cell, cx, cy, x, y, false);
+}
+
+// Goes position by position, and at every position offset by offset, the same as checking every position's neighbours would.
+// The next (position, offset) pair is looked up again after every update, in case it moved something.
+static void tsc_subtick_doNeighbourRow(tsc_subtick_t *subtick, int y) {
+    int x = 0;
+    int i = 0;
+    while(true) {
+        int bestX = -1;
+        int bestI = 0;
+        for(int j = 0; j < TSC_SUBTICK_NEIGHBOURS; j++) {
+            int tx = tsc_subtick_nextNeighbour(subtick, j, j >= i ? x : x + 1, y);
+            if(tx < 0) continue;
+            if(bestX < 0 || tx < bestX) {
+                bestX = tx;
+                bestI = j;
+            }
+        }
+        if(bestX < 0) break;
+        tsc_subtick_updateNeighbour(bestI, bestX, y);
+        x = bestX;
+        i = bestI + 1;
+        if(i == TSC_SUBTICK_NEIGHBOURS) {
+            x++;
+            i = 0;
+        }
+    }
+    tsc_subtick_flushBatch();
+}
+
+// Only call these on cells which are actually in the subtick
+
+// rots is a bitmask of the rotations which should update
+static void tsc_subtick_updateRotated(int x, int y, char rots) {
+    tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
+    if(!(rots & (1 << tsc_cell_getRotation(cell)))) return;
+    #ifndef TSC_TURBO
+    if(cell->updated) return;
+    #endif
+    tsc_celltable *table = tsc_cell_getTable(cell);
+    if(table == NULL) return;
+    if(!tsc_subtick_canUpdate(table)) return;
+    tsc_subtick_callUpdate(table, cell, x, y, x, y, true);
+}
+
+static void tsc_subtick_updateTracked(int x, int y, char rot) {
+    tsc_subtick_updateRotated(x, y, 1 << rot);
+}
+
+static char tsc_subtick_customMask(tsc_subtick_custom_order *order) {
+    char mask = 0;
+    for(int i = 0; i < order->rotc; i++) {
+        mask |= 1 << (order->rots[i] & 3);
+    }
+    return mask;
+}
+
+static size_t tsc_subtick_customCount(tsc_subtick_t *subtick) {
+    size_t count = 0;
+    while(subtick->customOrder[count] != NULL) count++;
+    return count;
+}
+
+// Does a pass of a custom order on one line, which is a row for 0 and 2 and a column for 1 and 3
+static void tsc_subtick_doCustomLine(tsc_subtick_t *subtick, tsc_subtick_custom_order *order, int line) {
+    char mask = tsc_subtick_customMask(order);
+    if(mask == 0) return;
+    int dir = order->order & 3;
+    if(dir == 0) {
+        for(int x = tsc_subtick_prevInRow(subtick, currentGrid->width - 1, line); x >= 0; x = tsc_subtick_prevInRow(subtick, x - 1, line)) {
+            tsc_subtick_updateRotated(x, line, mask);
+        }
+    }
+    if(dir == 1) {
+        for(int y = tsc_subtick_prevInColumn(subtick, line, currentGrid->height - 1); y >= 0; y = tsc_subtick_prevInColumn(subtick, line, y - 1)) {
+            tsc_subtick_updateRotated(line, y, mask);
+        }
+    }
+    if(dir == 2) {
+        for(int x = tsc_subtick_nextInRow(subtick, 0, line); x >= 0; x = tsc_subtick_nextInRow(subtick, x + 1, line)) {
+            tsc_subtick_updateRotated(x, line, mask);
+        }
+    }
+    if(dir == 3) {
+        for(int y = tsc_subtick_nextInColumn(subtick, line, 0); y >= 0; y = tsc_subtick_nextInColumn(subtick, line, y + 1)) {
+            tsc_subtick_updateRotated(line, y, mask);
+        }
+    }
+    tsc_subtick_flushBatch();
+}
+
+static void tsc_subtick_updateTicked(int x, int y) {
+    tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
+    #ifndef TSC_TURBO
+    if(cell->updated) return;
+    #endif
+    tsc_celltable *table = tsc_cell_getTable(cell);
+    if(table == NULL) return;
+    if(!tsc_subtick_canUpdate(table)) return;
+    tsc_subtick_callUpdate(table, cell, x, y, x, y, true);
+}
+
 static void tsc_subtick_worker(void *data) {
     tsc_updateinfo_t *info = data;
+    tsc_subtick_t *subtick = info->subtick;
 
-    char mode = info->subtick->mode;
+    char mode = subtick->mode;
 
     if(mode == TSC_SUBMODE_TRACKED) {
         char rot = info->rot;
+        int step = 1 + subtick->spacing;
         if(rot == 0) {
-            for(int x = currentGrid->width-1; x >= 0; x--) {
-                int y = info->x;
-                if(!tsc_grid_checkChunk(currentGrid, x, y)) {
-                    x = tsc_grid_chunkOff(x, 0);
-                    continue;
-                }
-                tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
-                if(cell == NULL) continue;
-                if(tsc_cell_getRotation(cell) != 0) continue;
-                #ifndef TSC_TURBO
-                if(cell->updated) continue;
-                #endif
-                for(size_t i = 0; i < info->subtick->idc; i++) {
-                    if(info->subtick->ids[i] == cell->id) {
-                        tsc_celltable *table = tsc_cell_getTable(cell);
-                        if(table == NULL) break; // breaks out of id loop.
-                        if(table->update == NULL) break;
-                        #ifndef TSC_TURBO
-                        cell->updated = true;
-                        #endif
-                        table->update(cell, x, y, x, y, table->payload);
-                        break;
-                    }
-                }
-            }
-            for(int x = 0; x < currentGrid->width; x++) {
-                int y = info->x;
-                if(!tsc_grid_checkChunk(currentGrid, x, y)) {
-                    x = tsc_grid_chunkOff(x, +1) - 1;
-                    continue;
+            for(int y = info->x; y < info->end; y += step) {
+                if(!tsc_subtick_checkRow(subtick, y)) continue;
+                tsc_grid_claimLine(&info->conflicts, 0, y);
+                for(int x = tsc_subtick_prevInRow(subtick, currentGrid->width - 1, y); x >= 0; x = tsc_subtick_prevInRow(subtick, x - 1, y)) {
+                    tsc_subtick_updateTracked(x, y, 0);
                 }
-                tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
-                if(cell == NULL) continue;
-                if(tsc_cell_getRotation(cell) != 2) continue;
-                #ifndef TSC_TURBO
-                if(cell->updated) continue;
-                #endif
-                for(size_t i = 0; i < info->subtick->idc; i++) {
-                    if(info->subtick->ids[i] == cell->id) {
-                        tsc_celltable *table = tsc_cell_getTable(cell);
-                        if(table == NULL) break; // breaks out of id loop.
-                        if(table->update == NULL) break;
-                        #ifndef TSC_TURBO
-                        cell->updated = true;
-                        #endif
-                        table->update(cell, x, y, x, y, table->payload);
-                        break;
-                    }
+                tsc_subtick_flushBatch();
+                for(int x = tsc_subtick_nextInRow(subtick, 0, y); x >= 0; x = tsc_subtick_nextInRow(subtick, x + 1, y)) {
+                    tsc_subtick_updateTracked(x, y, 2);
                 }
+                tsc_subtick_flushBatch();
             }
         }
         if(rot == 1) {
-            for(int y = 0; y < currentGrid->height; y++) {
-                int x = info->x;
-                if(!tsc_grid_checkChunk(currentGrid, x, y)) {
-                    y = tsc_grid_chunkOff(y, +1) - 1;
-                    continue;
+            for(int x = info->x; x < info->end; x += step) {
+                if(!tsc_subtick_checkColumn(subtick, x)) continue;
+                tsc_grid_claimLine(&info->conflicts, 1, x);
+                for(int y = tsc_subtick_nextInColumn(subtick, x, 0); y >= 0; y = tsc_subtick_nextInColumn(subtick, x, y + 1)) {
+                    tsc_subtick_updateTracked(x, y, 3);
                 }
-                tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
-                if(tsc_cell_getRotation(cell) != 3) continue;
-                #ifndef TSC_TURBO
-                if(cell->updated) continue;
-                #endif
-                for(size_t i = 0; i < info->subtick->idc; i++) {
-                    if(info->subtick->ids[i] == cell->id) {
-                        tsc_celltable *table = tsc_cell_getTable(cell);
-                        if(table == NULL) break; // breaks out of id loop.
-                        if(table->update == NULL) break;
-                        #ifndef TSC_TURBO
-                        cell->updated = true;
-                        #endif
-                        table->update(cell, x, y, x, y, table->payload);
-                        break;
-                    }
+                tsc_subtick_flushBatch();
+                for(int y = tsc_subtick_prevInColumn(subtick, x, currentGrid->height - 1); y >= 0; y = tsc_subtick_prevInColumn(subtick, x, y - 1)) {
+                    tsc_subtick_updateTracked(x, y, 1);
                 }
+                tsc_subtick_flushBatch();
             }
-            for(int y = currentGrid->height-1; y >= 0; y--) {
-                int x = info->x;
-                if(!tsc_grid_checkChunk(currentGrid, x, y)) {
-                    y = tsc_grid_chunkOff(y, 0);
-                    continue;
-                }
-                tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
-                if(tsc_cell_getRotation(cell) != 1) continue;
-                #ifndef TSC_TURBO
-                if(cell->updated) continue;
-                #endif
-                for(size_t i = 0; i < info->subtick->idc; i++) {
-                    if(info->subtick->ids[i] == cell->id) {
-                        tsc_celltable *table = tsc_cell_getTable(cell);
-                        if(table == NULL) break; // breaks out of id loop.
-                        if(table->update == NULL) break;
-                        #ifndef TSC_TURBO
-                        cell->updated = true;
-                        #endif
-                        table->update(cell, x, y, x, y, table->payload);
-                        break;
-                    }
-                }
+        }
+        tsc_grid_releaseLine();
+        return;
+    }
+
+    if(mode == TSC_SUBMODE_CUSTOM) {
+        int step = 1 + subtick->spacing;
+        for(int line = info->x; line < info->end; line += step) {
+            bool active = info->rot == 0 ? tsc_subtick_checkRow(subtick, line) : tsc_subtick_checkColumn(subtick, line);
+            if(!active) continue;
+            tsc_grid_claimLine(&info->conflicts, info->rot, line);
+            for(int i = info->order; i < info->orderEnd; i++) {
+                tsc_subtick_doCustomLine(subtick, subtick->customOrder[i], line);
             }
         }
+        tsc_grid_releaseLine();
         return;
     }
 
     if(mode == TSC_SUBMODE_TICKED) {
-        for(int y = 0; y < currentGrid->height; y++) {
-            if(!tsc_grid_checkChunk(currentGrid, info->x, y)) {
-                y = tsc_grid_chunkOff(y, +1) - 1;
-                continue;
-            }
-            tsc_cell *cell = tsc_grid_get(currentGrid, info->x, y);
-            for(size_t i = 0; i < info->subtick->idc; i++) {
-                if(info->subtick->ids[i] == cell->id) {
-                    tsc_celltable *table = tsc_cell_getTable(cell);
-                    if(table == NULL) break; // breaks out of id loop.
-                    if(table->update == NULL) break;
-                    #ifndef TSC_TURBO
-                    cell->updated = true;
-                    #endif
-                    table->update(cell, info->x, y, info->x, y, table->payload);
-                    break;
-                }
-            }
+        int x = info->x;
+        tsc_grid_claimLine(&info->conflicts, 1, x);
+        for(int y = tsc_subtick_nextInColumn(subtick, x, 0); y >= 0; y = tsc_subtick_nextInColumn(subtick, x, y + 1)) {
+            tsc_subtick_updateTicked(x, y);
         }
+        tsc_subtick_flushBatch();
+        tsc_grid_releaseLine();
         return;
     }
     
     if(mode == TSC_SUBMODE_NEIGHBOUR) {
-        int off[] = {
-            -1, 0,
-            1, 0,
-            0, -1,
-            0, 1
-        };
-        int offc = 4;
-        for(int i = 0; i < offc; i++) {
-            for(int x = 0; x < currentGrid->width; x++) {
-                int y = info->x;
-                if(!tsc_grid_checkChunk(currentGrid, x, y)) {
-                    x = tsc_grid_chunkOff(x, +1) - 1;
-                    continue;
-                }
-                int cx = x + off[i*2];
-                int cy = y + off[i*2+1];
-                tsc_cell *cell = tsc_grid_get(currentGrid, cx, cy);
-                if(cell == NULL) continue;
-                for(size_t i = 0; i < info->subtick->idc; i++) {
-                    if(info->subtick->ids[i] == cell->id) {
-                        tsc_celltable *table = tsc_cell_getTable(cell);
-                        if(table == NULL) break; // breaks out of id loop.
-                        if(table->update == NULL) break;
-                        table->update(cell, cx, cy, x, y, table->payload);
-                        break;
-                    }
-                }
-            }
-        }
+        int y = info->x;
+        tsc_grid_claimLine(&info->conflicts, 0, y);
+        tsc_subtick_doNeighbourRow(subtick, y);
+        tsc_grid_releaseLine();
         return;
     }
 }
 
+// Runs the tasks and adds up their conflicts. Once there were any, the subtick can't be trusted to stay on its lines anymore.
+static void tsc_subtick_runTasks(tsc_subtick_t *subtick, tsc_updateinfo_t *buffer, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        buffer[i].conflicts = 0;
+    }
+    workers_waitForTasksFlat(&tsc_subtick_worker, buffer, sizeof(tsc_updateinfo_t), len);
+    size_t conflicts = 0;
+    for(size_t i = 0; i < len; i++) {
+        conflicts += buffer[i].conflicts;
+    }
+    if(conflicts == 0) return;
+    if(subtick->parallel) {
+        fprintf(stderr, "Subtick %s left its lines while running in parallel, so it runs serially from now on\n", subtick->name);
+    }
+    subtick->conflicts += conflicts;
+    subtick->parallel = 0;
+}
+
 static void tsc_subtick_doMover(struct tsc_cell *cell, int x, int y, int _ux, int _uy, void *_) {
     tsc_grid_push(currentGrid, x, y, tsc_cell_getRotation(cell), 0, NULL);
 }
@@ -330,6 +539,11 @@ static void tsc_subtick_doGen(struct tsc_cell *cell, int x, int y, int _ux, int
     int fx = tsc_grid_frontX(x, rot);
     int fy = tsc_grid_frontY(y, rot);
 #ifndef TSC_TURBO
+    // Nothing it depends on changed since it last failed
+    if(tsc_grid_isBlocked(currentGrid, x, y, rot)) {
+        tsc_grid_setOptimization(currentGrid, x, y, builtin.optimizations.gens[(size_t)rot], true);
+        return;
+    }
     tsc_cell *front = tsc_grid_get(currentGrid, fx, fy);
     if(front == NULL) return;
     if(front->id != builtin.empty && tsc_grid_checkOptimization(currentGrid, fx, fy, builtin.optimizations.gens[(size_t)rot])) {
@@ -344,6 +558,15 @@ static void tsc_subtick_doGen(struct tsc_cell *cell, int x, int y, int _ux, int
     if(!tsc_cell_canGenerate(currentGrid, back, bx, by, cell, x, y, rot)) return;
     if(tsc_grid_push(currentGrid, fx, fy, rot, 1, back) == 0) {
         tsc_grid_setOptimization(currentGrid, x, y, builtin.optimizations.gens[(size_t)rot], true);
+#ifndef TSC_TURBO
+        // The back, the generator and everything the push looked at
+        int len = tsc_grid_failedPushLength() + 2;
+        for(int i = -1; i < len - 1; i++) {
+            tsc_cell *inLine = tsc_grid_get(currentGrid, tsc_grid_shiftX(x, rot, i), tsc_grid_shiftY(y, rot, i));
+            if(!(tsc_cellCapabilities[inLine->id] & TSC_CAP_NO_HOOKS)) return;
+        }
+        tsc_grid_setBlocked(currentGrid, x, y, rot, len);
+#endif
     }
 }
 
@@ -361,12 +584,63 @@ static void tsc_subtick_doCounterClockwiseRotator(struct tsc_cell *cell, int x,
     tsc_cell_rotate(toRot, -1);
 }
 
+// How busy a line is, used to balance the strips
+static int tsc_subtick_lineWeight(tsc_subtick_t *subtick, int line, char rot) {
+    if(subtick->cellIndex != TSC_NO_INDEX) {
+        if(rot == 0) return tsc_grid_countIndexedRow(currentGrid, subtick->cellIndex, line);
+        return tsc_grid_countIndexedColumn(currentGrid, subtick->cellIndex, line);
+    }
+    // No index, so all we know is how many chunks are enabled along it
+    if(rot == 0) return atomic_load_explicit(currentGrid->chunkRowCounts + (line >> currentGrid->chunkshift), memory_order_relaxed);
+    return atomic_load_explicit(currentGrid->chunkColumnCounts + (line >> currentGrid->chunkshift), memory_order_relaxed);
+}
+
+// Lines which are (spacing + 1) apart never touch each other, so they can be ran in any order.
+// Instead of one task per line, we group neighbouring lines into strips of roughly equal work, a few per worker,
+// so a build crammed into one corner still gets spread across every thread and empty lines cost nothing.
+static size_t tsc_subtick_buildStrips(tsc_subtick_t *subtick, tsc_updateinfo_t *buffer, char space, char rot) {
+    int lines = rot == 0 ? currentGrid->height : currentGrid->width;
+    int step = 1 + subtick->spacing;
+
+    long total = 0;
+    for(int line = space; line < lines; line += step) {
+        total += tsc_subtick_lineWeight(subtick, line, rot);
+    }
+    if(total == 0) return 0;
+    long target = total / (workers_amount() * 4 + 1);
+    if(target < 1) target = 1;
+
+    size_t j = 0;
+    long weight = 0;
+    for(int line = space; line < lines; line += step) {
+        int w = tsc_subtick_lineWeight(subtick, line, rot);
+        if(w == 0) continue;
+        if(weight == 0) {
+            buffer[j].x = line;
+            buffer[j].rot = rot;
+            buffer[j].subtick = subtick;
+        }
+        weight += w;
+        buffer[j].end = line + 1;
+        if(weight >= target) {
+            j++;
+            weight = 0;
+        }
+    }
+    if(weight != 0) j++;
+    return j;
+}
+
+// Set while tsc_subtick_runVerified runs its reference, so it goes through the serial loops without touching the workers
+static bool tsc_subtick_forceSerial = false;
+
 static void tsc_subtick_do(tsc_subtick_t *subtick) {
     char mode = subtick->mode;
     char parallel = subtick->parallel;
     #ifdef TSC_SINGLE_THREAD
     parallel = 0;
     #endif
+    if(tsc_subtick_forceSerial) parallel = 0;
     // Not worth the overhead
     if(currentGrid->width * currentGrid->height < 10000) parallel = 0;
     if(workers_isDisabled()) parallel = 0;
@@ -378,278 +652,312 @@ static void tsc_subtick_do(tsc_subtick_t *subtick) {
 
     if(mode == TSC_SUBMODE_TRACKED) {
         if(parallel) {
-            tsc_updateinfo_t *buffer = subticks_getBuffer(currentGrid->width < currentGrid->height ? currentGrid->height : currentGrid->width);
+            tsc_updateinfo_t *buffer = subticks_newBuffer(currentGrid->width < currentGrid->height ? currentGrid->height : currentGrid->width);
 
             for(char space = 0; space <= spacing; space++) {
+                // Rows first, then columns
                 for(char i = 0; i < 2; i++) {
-                    if(i == 1) {
-                        size_t j = 0;
-                        for(size_t x = space; x < currentGrid->width; x += 1 + spacing) {
-                            if(!tsc_grid_checkColumn(currentGrid, x)) {
-                                continue;
-                            }
-                            buffer[j].x = x;
-                            buffer[j].rot = 1;
-                            buffer[j].subtick = subtick;
-                            j++;
-                        }
-
-                        workers_waitForTasksFlat(&tsc_subtick_worker, buffer, sizeof(tsc_updateinfo_t), j);
-                    } else {
-                        size_t j = 0;
-                        for(size_t y = space; y < currentGrid->height; y += 1 + spacing) {
-                            if(!tsc_grid_checkRow(currentGrid, y)) {
-                                continue;
-                            }
-                            buffer[j].x = y;
-                            buffer[j].rot = 0;
-                            buffer[j].subtick = subtick;
-                            j++;
-                        }
-
-                        workers_waitForTasksFlat(&tsc_subtick_worker, buffer, sizeof(tsc_updateinfo_t), j);
-                    }
+                    size_t j = tsc_subtick_buildStrips(subtick, buffer, space, i);
+                    tsc_subtick_runTasks(subtick, buffer, j);
                 }
             }
+            free(buffer);
             return;
         }
         for(int i = 0; i < rotc; i++) {
             char rot = rots[i];
             if(rot == 0) {
                 for(int y = 0; y < currentGrid->height; y++) {
-                    for(int x = currentGrid->width - 1; x >= 0; x--) {
-                        tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
-                        #ifndef TSC_TURBO
-                        if(cell->updated) continue;
-                        #endif
-                        if(tsc_cell_getRotation(cell) != rot) continue;
-                        for(size_t i = 0; i < subtick->idc; i++) {
-                            if(subtick->ids[i] == cell->id) {
-                                #ifndef TSC_TURBO
-                                cell->updated = true;
-                                #endif
-                                tsc_celltable *table = tsc_cell_getTable(cell);
-                                if(table == NULL) break;
-                                if(table->update == NULL) break;
-                                table->update(cell, x, y, x, y, table->payload);
-                            }
-                        }
+                    if(!tsc_subtick_checkRow(subtick, y)) continue;
+                    for(int x = tsc_subtick_prevInRow(subtick, currentGrid->width - 1, y); x >= 0; x = tsc_subtick_prevInRow(subtick, x - 1, y)) {
+                        tsc_subtick_updateTracked(x, y, rot);
                     }
+                    tsc_subtick_flushBatch();
                 }
             }
             if(rot == 1) {
                 for(int x = 0; x < currentGrid->width; x++) {
-                    for(int y = currentGrid->height-1; y >= 0; y--) {
-                        tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
-                        #ifndef TSC_TURBO
-                        if(cell->updated) continue;
-                        #endif
-                        if(tsc_cell_getRotation(cell) != rot) continue;
-                        for(size_t i = 0; i < subtick->idc; i++) {
-                            if(subtick->ids[i] == cell->id) {
-                                #ifndef TSC_TURBO
-                                cell->updated = true;
-                                #endif
-                                tsc_celltable *table = tsc_cell_getTable(cell);
-                                if(table == NULL) break;
-                                if(table->update == NULL) break;
-                                table->update(cell, x, y, x, y, table->payload);
-                            }
-                        }
+                    if(!tsc_subtick_checkColumn(subtick, x)) continue;
+                    for(int y = tsc_subtick_prevInColumn(subtick, x, currentGrid->height - 1); y >= 0; y = tsc_subtick_prevInColumn(subtick, x, y - 1)) {
+                        tsc_subtick_updateTracked(x, y, rot);
                     }
+                    tsc_subtick_flushBatch();
                 }
             }
             if(rot == 2) {
                 for(int y = 0; y < currentGrid->height; y++) {
-                    for(int x = 0; x < currentGrid->width; x++) {
-                        tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
-                        #ifndef TSC_TURBO
-                        if(cell->updated) continue;
-                        #endif
-                        if(tsc_cell_getRotation(cell) != rot) continue;
-                        for(size_t i = 0; i < subtick->idc; i++) {
-                            if(subtick->ids[i] == cell->id) {
-                                #ifndef TSC_TURBO
-                                cell->updated = true;
-                                #endif
-                                tsc_celltable *table = tsc_cell_getTable(cell);
-                                if(table == NULL) break;
-                                if(table->update == NULL) break;
-                                table->update(cell, x, y, x, y, table->payload);
-                            }
-                        }
+                    if(!tsc_subtick_checkRow(subtick, y)) continue;
+                    for(int x = tsc_subtick_nextInRow(subtick, 0, y); x >= 0; x = tsc_subtick_nextInRow(subtick, x + 1, y)) {
+                        tsc_subtick_updateTracked(x, y, rot);
                     }
+                    tsc_subtick_flushBatch();
                 }
             }
             if(rot == 3) {
                 for(int x = 0; x < currentGrid->width; x++) {
-                    for(int y = 0; y < currentGrid->height; y++) {
-                        tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
-                        #ifndef TSC_TURBO
-                        if(cell->updated) continue;
-                        #endif
-                        if(tsc_cell_getRotation(cell) != rot) continue;
-                        for(size_t i = 0; i < subtick->idc; i++) {
-                            if(subtick->ids[i] == cell->id) {
-                                #ifndef TSC_TURBO
-                                cell->updated = true;
-                                #endif
-                                tsc_celltable *table = tsc_cell_getTable(cell);
-                                if(table == NULL) break;
-                                if(table->update == NULL) break;
-                                table->update(cell, x, y, x, y, table->payload);
-                            }
-                        }
+                    if(!tsc_subtick_checkColumn(subtick, x)) continue;
+                    for(int y = tsc_subtick_nextInColumn(subtick, x, 0); y >= 0; y = tsc_subtick_nextInColumn(subtick, x, y + 1)) {
+                        tsc_subtick_updateTracked(x, y, rot);
                     }
+                    tsc_subtick_flushBatch();
                 }
             }
         }
     }
     
+    if(mode == TSC_SUBMODE_CUSTOM) {
+        size_t orderc = tsc_subtick_customCount(subtick);
+        if(parallel) {
+            tsc_updateinfo_t *buffer = subticks_newBuffer(currentGrid->width < currentGrid->height ? currentGrid->height : currentGrid->width);
+
+            for(char space = 0; space <= spacing; space++) {
+                // Passes along the same axis in a row don't need to wait for each other, since lines are independent
+                for(size_t i = 0; i < orderc;) {
+                    char axis = subtick->customOrder[i]->order & 1;
+                    size_t end = i + 1;
+                    while(end < orderc && (subtick->customOrder[end]->order & 1) == axis) end++;
+                    size_t j = tsc_subtick_buildStrips(subtick, buffer, space, axis);
+                    for(size_t k = 0; k < j; k++) {
+                        buffer[k].order = i;
+                        buffer[k].orderEnd = end;
+                    }
+                    tsc_subtick_runTasks(subtick, buffer, j);
+                    i = end;
+                }
+            }
+            free(buffer);
+            return;
+        }
+        for(size_t i = 0; i < orderc; i++) {
+            tsc_subtick_custom_order *order = subtick->customOrder[i];
+            if(order->order & 1) {
+                for(int x = 0; x < currentGrid->width; x++) {
+                    if(!tsc_subtick_checkColumn(subtick, x)) continue;
+                    tsc_subtick_doCustomLine(subtick, order, x);
+                }
+            } else {
+                for(int y = 0; y < currentGrid->height; y++) {
+                    if(!tsc_subtick_checkRow(subtick, y)) continue;
+                    tsc_subtick_doCustomLine(subtick, order, y);
+                }
+            }
+        }
+    }
+
     if(mode == TSC_SUBMODE_NEIGHBOUR) {
         if(parallel) {
-            tsc_updateinfo_t *buffer = subticks_getBuffer(currentGrid->width);
+            tsc_updateinfo_t *buffer = subticks_newBuffer(currentGrid->height);
             for(char space = 0; space <= spacing; space++) {
                 // per-row for cache friendliness
                 int j = 0;
                 for(size_t y = space; y < currentGrid->height; y += 1 + spacing) {
-                    if(!tsc_grid_checkRow(currentGrid, y)) continue;
+                    if(!tsc_subtick_nearRow(subtick, y)) continue;
                     buffer[j].x = y;
+                    buffer[j].end = y + 1;
                     buffer[j].subtick = subtick;
                     j++;
                 }
 
-                workers_waitForTasksFlat(&tsc_subtick_worker, buffer, sizeof(tsc_updateinfo_t), j);
+                tsc_subtick_runTasks(subtick, buffer, j);
             }
+            free(buffer);
             return;
         }
-        // Single-threaded
         for(int y = 0; y < currentGrid->height; y++) {
-            for(int x = 0; x < currentGrid->width; x++) {
-                int off[] = {
-                    -1, 0,
-                    1, 0,
-                    0, -1,
-                    0, 1
-                };
-                int offc = 4;
-                for(int i = 0; i < offc; i++) {
-                    int cx = x + off[i*2];
-                    int cy = y + off[i*2+1];
-                    tsc_cell *cell = tsc_grid_get(currentGrid, cx, cy);
-                    if(cell == NULL) continue;
-                    for(size_t i = 0; i < subtick->idc; i++) {
-                        if(subtick->ids[i] == cell->id) {
-                            tsc_celltable *table = tsc_cell_getTable(cell);
-                            if(table == NULL) break;
-                            if(table->update == NULL) break;
-                            table->update(cell, cx, cy, x, y, table->payload);
-                            break;
-                        }
-                    }
-                }
-            }
+            if(!tsc_subtick_nearRow(subtick, y)) continue;
+            tsc_subtick_doNeighbourRow(subtick, y);
         }
     }
 
     if(mode == TSC_SUBMODE_TICKED) {
         if(parallel) {
-            tsc_updateinfo_t *buffer = subticks_getBuffer(currentGrid->width);
+            tsc_updateinfo_t *buffer = subticks_newBuffer(currentGrid->width);
             for(char space = 0; space <= spacing; space++) {
                 int j = 0;
                 for(size_t x = space; x < currentGrid->width; x += 1 + spacing) {
-                    if(!tsc_grid_checkColumn(currentGrid, x)) continue;
+                    if(!tsc_subtick_checkColumn(subtick, x)) continue;
                     buffer[j].x = x;
+                    buffer[j].end = x + 1;
                     buffer[j].subtick = subtick;
                     j++;
                 }
 
-                workers_waitForTasksFlat(&tsc_subtick_worker, buffer, sizeof(tsc_updateinfo_t), j);
+                tsc_subtick_runTasks(subtick, buffer, j);
             }
+            free(buffer);
             return;
         }
         // Single-threaded
         for(int x = 0; x < currentGrid->width; x++) {
-            for(int y = 0; y < currentGrid->height; y++) {
-                tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
-                #ifndef TSC_TURBO
-                if(cell->updated) continue;
-                #endif
-                for(size_t i = 0; i < subtick->idc; i++) {
-                    if(subtick->ids[i] == cell->id) {
-                        tsc_celltable *table = tsc_cell_getTable(cell);
-                        if(table == NULL) break;
-                        if(table->update == NULL) break;
-                        #ifndef TSC_TURBO
-                        cell->updated = true;
-                        #endif
-                        table->update(cell, x, y, x, y, table->payload);
-                        break;
-                    }
-                }
+            if(!tsc_subtick_checkColumn(subtick, x)) continue;
+            for(int y = tsc_subtick_nextInColumn(subtick, x, 0); y >= 0; y = tsc_subtick_nextInColumn(subtick, x, y + 1)) {
+                tsc_subtick_updateTicked(x, y);
             }
+            tsc_subtick_flushBatch();
         }
     }
 }
 
-#ifndef TSC_TURBO
-static void tsc_subtick_reset(void *data) {
-    // Super smart optimization
-    // If you don't understand, me neither
-    size_t x = (size_t)data;
-    size_t optSize = tsc_optSize();
-
-    for(size_t y = 0; y < currentGrid->height; y++) {
-        if(!tsc_grid_checkChunk(currentGrid, x, y)) {
-            size_t i = x + y * currentGrid->width;
-            y += tsc_gridChunkSize - 1;
-            continue;
+// Subticks next to each other which all commute with each other make up a stage
+static size_t tsc_subtick_stageEnd(size_t start) {
+    size_t end = start + 1;
+    while(end < subticks.subc) {
+        for(size_t i = start; i < end; i++) {
+            if(!tsc_subtick_commutesWith(subticks.subs + i, subticks.subs + end)) return end;
         }
-        tsc_cell *cell = tsc_grid_get(currentGrid, x, y);
-        cell->updated = false;
-        cell->lx = x;
-        cell->ly = y;
-        char rot = tsc_cell_getRotation(cell);
-        cell->rotData = rot;
-        size_t i = x + y * currentGrid->width;
-        memset(currentGrid->optData + i * optSize, 0, optSize);
-        // TODO: cell reset method
+        end++;
     }
+    return end;
 }
-#endif
 
-void tsc_subtick_run() {
-#ifndef TSC_TURBO
-    if(storeExtraGraphicInfo) {
-        tsc_trashedCellCount = 0; // yup, yup, yup
+typedef struct tsc_subtick_stage_task_t {
+    tsc_subtick_t *subtick;
+    double time;
+} tsc_subtick_stage_task_t;
+
+static void tsc_subtick_doStaged(void *data) {
+    tsc_subtick_stage_task_t *task = data;
+    double start = tsc_clock();
+    tsc_subtick_do(task->subtick);
+    task->time = tsc_clock() - start;
+}
+
+// The whole stage is one job, so the subticks in it only wait for each other once at the end.
+// Their own parallel passes get split among whichever workers are free.
+static void tsc_subtick_doStage(size_t start, size_t end, tsc_subtick_profile_t *profile) {
+    size_t len = end - start;
+    tsc_subtick_stage_task_t *tasks = malloc(sizeof(tsc_subtick_stage_task_t) * len);
+    for(size_t i = 0; i < len; i++) {
+        tasks[i].subtick = subticks.subs + start + i;
+        tasks[i].time = 0;
     }
-    char shouldBeParallel = 1;
-    #ifdef TSC_SINGLE_THREAD
-        shouldBeParallel = 0;
-    #endif
-    if(workers_isDisabled()) shouldBeParallel = 0;
-    if(currentGrid->width * currentGrid->height < 10000) shouldBeParallel = 0;
-    if(shouldBeParallel) {
-        // This absolutely evil hack will call the tsc_subtick_reset with a data pointer who's address is the x.
-        // I don't care about how horribly unsafe this is or how much better this could be in Rust,
-        // this is the fastest way to reset the grid in parallel.
-        workers_waitForTasksFlat(&tsc_subtick_reset, 0, 1, currentGrid->width);
+#ifdef TSC_SINGLE_THREAD
+    for(size_t i = 0; i < len; i++) tsc_subtick_doStaged(tasks + i);
+#else
+    if(tsc_subtick_forceSerial) {
+        for(size_t i = 0; i < len; i++) tsc_subtick_doStaged(tasks + i);
     } else {
-        for(size_t i = 0; i < currentGrid->width; i++) {
-            if(!tsc_grid_checkColumn(currentGrid, i)) {
-                i += tsc_gridChunkSize - 1;
-                continue;
-            }
-            // Cast it to bullshit
-            void *bullshit = (void *)i;
-            tsc_subtick_reset(bullshit);
-        }
+        workers_waitForTasksFlat(&tsc_subtick_doStaged, tasks, sizeof(tsc_subtick_stage_task_t), len);
     }
 #endif
+    if(profile != NULL) {
+        for(size_t i = 0; i < len; i++) {
+            if(start + i < profile->subc) profile->subtickTimes[start + i] += tasks[i].time;
+        }
+    }
+    free(tasks);
+}
+
+void tsc_subtick_run() {
+    tsc_subtick_runProfiled(NULL);
+}
 
+// Everything a tick does to the current grid before the subticks
+static void tsc_subtick_prepare() {
+    // Only does anything after loading or switching grids
+    tsc_grid_syncIndices(currentGrid);
+    tsc_cell_refreshCapabilities();
+    // Chunks only ever get enabled while ticking, so this is where they die
+    tsc_grid_sweepChunks(currentGrid);
+    // Only what changed last tick needs resetting
+    tsc_grid_resetDirty(currentGrid);
     for(size_t i = 0; i < subticks.subc; i++) {
-        tsc_subtick_do(subticks.subs + i);
+        subticks.subs[i].conflicts = 0;
+    }
+}
+
+// Runs the stage starting at start and returns where the next one starts
+static size_t tsc_subtick_runStage(size_t start, tsc_subtick_profile_t *profile, double *last) {
+    size_t end = tsc_subtick_stageEnd(start);
+    if(end - start == 1) {
+        tsc_subtick_do(subticks.subs + start);
+        if(profile != NULL) {
+            double now = tsc_clock();
+            if(start < profile->subc) profile->subtickTimes[start] += now - *last;
+            *last = now;
+        }
+    } else {
+        tsc_subtick_doStage(start, end, profile);
+        if(profile != NULL) *last = tsc_clock();
+    }
+    return end;
+}
+
+void tsc_subtick_runProfiled(tsc_subtick_profile_t *profile) {
+    double start = profile == NULL ? 0 : tsc_clock();
+    tsc_subtick_prepare();
+
+    double last = profile == NULL ? 0 : tsc_clock();
+    if(profile != NULL) profile->reset += last - start;
+    for(size_t i = 0; i < subticks.subc;) {
+        i = tsc_subtick_runStage(i, profile, &last);
+    }
+    tsc_publishTrashedCells();
+}
+
+bool tsc_subtick_runVerified(tsc_subtick_divergence_t *divergence) {
+    return tsc_subtick_runVerifiedProfiled(divergence, NULL);
+}
+
+bool tsc_subtick_runVerifiedProfiled(tsc_subtick_divergence_t *divergence, tsc_subtick_profile_t *profile) {
+    double start = profile == NULL ? 0 : tsc_clock();
+    tsc_subtick_prepare();
+    if(profile != NULL) profile->reset += tsc_clock() - start;
+
+    tsc_grid *live = currentGrid;
+    // It lives in the grid storage so nuking the grids gets rid of it too
+    tsc_grid *serial = tsc_getGrid("tsc:verify");
+    if(serial == NULL) serial = tsc_createGrid("tsc:verify", live->width, live->height, NULL, NULL);
+    tsc_copyGrid(serial, live);
+
+    bool prepared = false;
+    bool same = true;
+    double last = 0;
+    for(size_t i = 0; i < subticks.subc;) {
+        if(!same) {
+            last = profile == NULL ? 0 : tsc_clock();
+            i = tsc_subtick_runStage(i, profile, &last);
+            continue;
+        }
+
+        // The grids are swapped behind everyone's back, switching would invalidate the live grid's indices
+        currentGrid = serial;
+        if(!prepared) {
+            tsc_subtick_prepare();
+            prepared = true;
+        }
+        // Whatever the copy trashes shouldn't get drawn
+        bool fancy = storeExtraGraphicInfo;
+        storeExtraGraphicInfo = false;
+        tsc_subtick_forceSerial = true;
+        tsc_subtick_runStage(i, NULL, &last);
+        tsc_subtick_forceSerial = false;
+        storeExtraGraphicInfo = fancy;
+        currentGrid = live;
+
+        // Only the run with the workers counts for the profile
+        last = profile == NULL ? 0 : tsc_clock();
+        size_t end = tsc_subtick_runStage(i, profile, &last);
+
+        int x, y;
+        size_t cells = tsc_diffGrids(serial, live, &x, &y);
+        if(cells > 0) {
+            same = false;
+            if(divergence != NULL) {
+                divergence->subtick = subticks.subs[i].name;
+                divergence->x = x;
+                divergence->y = y;
+                divergence->cells = cells;
+                divergence->conflicts = 0;
+                for(size_t j = i; j < end; j++) {
+                    divergence->conflicts += subticks.subs[j].conflicts;
+                }
+            }
+        }
+        i = end;
     }
+    tsc_publishTrashedCells();
+    return same;
 }
 
 void tsc_subtick_addCore() {
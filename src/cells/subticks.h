@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "../cells/grid.h"
 
 #define TSC_SUBMODE_TICKED 0
@@ -10,6 +11,9 @@
 #define TSC_SUBMODE_NEIGHBOUR 2
 #define TSC_SUBMODE_CUSTOM 3
 
+// A custom subtick is a list of passes. order is the direction of the pass, the same way tracked subticks go
+// (0 is right, which scans rows from right to left so the cells in front go first, 1 is down, 2 is left and 3 is up),
+// and rots are which rotations get updated during it. Tracked subticks are {0, [0]}, {2, [2]}, {3, [3]}, {1, [1]}.
 typedef struct tsc_subtick_custom_order {
     int order;
     int rotc;
@@ -19,6 +23,8 @@ typedef struct tsc_subtick_custom_order {
 typedef struct tsc_subtick_t {
     tsc_id_t *ids;
     size_t idc;
+    // Position index of the cells in ids, or TSC_NO_INDEX if we ran out.
+    size_t cellIndex;
     const char *name;
     union {
         tsc_subtick_custom_order **customOrder;
@@ -27,12 +33,27 @@ typedef struct tsc_subtick_t {
     char mode;
     char parallel;
     char spacing;
+    // Names of the subticks this one commutes with, see tsc_subtick_commute
+    const char **commutes;
+    size_t commutec;
+    // How many pushes, pulls and writes left their line this tick while running in parallel, see tsc_grid_claimLine.
+    // If this isn't 0, this tick might have gone differently with another thread count. The subtick stops being parallel
+    // right after, so only the first tick it happens on can be off.
+    size_t conflicts;
+    // Bit per ID, set for the ones in ids. Built by tsc_subtick_add and kept up to date by tsc_subtick_addCell.
+    uint64_t *idBits;
 } tsc_subtick_t;
 
 typedef struct tsc_updateinfo_t {
     tsc_subtick_t *subtick;
     int x;
+    // Tracked subticks get a strip of every (spacing + 1)th line from x up to (but excluding) end
+    int end;
+    // Custom subticks do the orders from order up to (but excluding) orderEnd on every line
+    int order;
+    int orderEnd;
     char rot;
+    size_t conflicts;
 } tsc_updateinfo_t;
 
 typedef struct tsc_subtick_manager_t {
@@ -49,7 +70,40 @@ tsc_subtick_t *tsc_subtick_addTicked(const char *name, double priority, char spa
 tsc_subtick_t *tsc_subtick_addTracked(const char *name, double priority, char spacing, bool parallel);
 tsc_subtick_t *tsc_subtick_addNeighbour(const char *name, double priority, char spacing, bool parallel);
 tsc_subtick_t *tsc_subtick_addCustom(const char *name, double priority, char spacing, bool parallel, tsc_subtick_custom_order *orders, size_t orderc);
+// Declares that a and b can run at the same time, in any order, because they never touch the same cells (or it doesn't matter if they do).
+// Subticks next to each other (by priority) which all commute with each other run concurrently as one stage.
+void tsc_subtick_commute(tsc_subtick_t *a, tsc_subtick_t *b);
+// Time spent in each part of a tick, in seconds. Times are added, not set, so it can accumulate across ticks.
+// subtickTimes is indexed like subticks.subs and must have room for subc entries.
+typedef struct tsc_subtick_profile_t {
+    double reset;
+    double *subtickTimes;
+    size_t subc;
+} tsc_subtick_profile_t;
+
 void tsc_subtick_addCore();
 void tsc_subtick_run();
+void tsc_subtick_runProfiled(tsc_subtick_profile_t *profile);
+
+// Where a verified tick first went differently
+typedef struct tsc_subtick_divergence_t {
+    // The subtick after which the grids were different. If it ran as part of a stage, this is the first one in the stage.
+    const char *subtick;
+    // The first different position, left to right, top to bottom
+    int x;
+    int y;
+    // How many positions were different
+    size_t cells;
+    // The conflicts the stage's subticks had on that tick. If it's 0, something raced without leaving its line.
+    size_t conflicts;
+} tsc_subtick_divergence_t;
+
+// Runs a tick on the current grid with the workers, and the same tick on a copy through the serial loops, one stage at a time.
+// After every stage the two are compared. Returns false and fills in divergence if they ever differ.
+// The current grid keeps the result from the workers. It's a lot slower than a normal tick, so it's only for
+// catching parallel subticks which don't do the same as the serial ones.
+bool tsc_subtick_runVerified(tsc_subtick_divergence_t *divergence);
+// Same, but the profile only gets the time spent on the current grid, not on the copy
+bool tsc_subtick_runVerifiedProfiled(tsc_subtick_divergence_t *divergence, tsc_subtick_profile_t *profile);
 
 #endif
@@ -23,6 +23,22 @@ char *volatile initialCode = NULL;
 static mtx_t renderingUselessMutex;
 static cnd_t renderingTickUpdateSignal;
 
+// tickTime is moved along by the renderer every frame, so there is no exact deadline to sleep until.
+// We sleep for however long is left, but never more than this, so speeding up time doesn't add latency.
+#define TSC_UPDATE_MAX_SLEEP 0.002
+// Unpausing and stepping wake us up, this is just in case something else changes isGamePaused
+#define TSC_UPDATE_PAUSED_SLEEP 0.1
+
+// renderingUselessMutex must be locked
+static void tsc_updateThreadSleep(double seconds) {
+    struct timespec deadline;
+    timespec_get(&deadline, TIME_UTC);
+    long nsec = deadline.tv_nsec + (long)(seconds * 1000000000);
+    deadline.tv_sec += nsec / 1000000000;
+    deadline.tv_nsec = nsec % 1000000000;
+    cnd_timedwait(&renderingTickUpdateSignal, &renderingUselessMutex, &deadline);
+}
+
 // Asynchronous updating
 static int tsc_gridUpdateThread(void *_) {
     mtx_lock(&renderingUselessMutex);
@@ -32,12 +48,17 @@ static int tsc_gridUpdateThread(void *_) {
     while(true) {
         bool wasPaused = isGamePaused;
         if(multiTickPerFrame) {
-            if((tickTime < tickDelay || isGamePaused) && !onlyOneTick) {
+            if(isGamePaused && !onlyOneTick) {
+                tsc_updateThreadSleep(TSC_UPDATE_PAUSED_SLEEP);
+                continue;
+            }
+            if(tickTime < tickDelay && !onlyOneTick) {
+                double left = tickDelay - tickTime;
+                tsc_updateThreadSleep(left < TSC_UPDATE_MAX_SLEEP ? left : TSC_UPDATE_MAX_SLEEP);
                 continue;
             }
         } else {
             cnd_wait(&renderingTickUpdateSignal, &renderingUselessMutex);
-            mtx_unlock(&renderingUselessMutex);
         }
         if(!isGamePaused && wasPaused) {
             time(&last);
@@ -0,0 +1,196 @@
+#include "engine.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#ifdef TSC_HEADLESS
+#include <zlib.h>
+
+unsigned char *tsc_engine_compress(const unsigned char *data, size_t len, size_t *outLen) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // Negative window bits means raw DEFLATE, which is what raylib spits out
+    if(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return NULL;
+
+    size_t cap = deflateBound(&stream, len);
+    unsigned char *out = malloc(cap);
+    stream.next_in = (unsigned char *)data;
+    stream.avail_in = len;
+    stream.next_out = out;
+    stream.avail_out = cap;
+
+    int status = deflate(&stream, Z_FINISH);
+    *outLen = stream.total_out;
+    deflateEnd(&stream);
+    if(status != Z_STREAM_END) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+unsigned char *tsc_engine_decompress(const unsigned char *data, size_t len, size_t *outLen) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if(inflateInit2(&stream, -15) != Z_OK) return NULL;
+
+    size_t cap = len * 4 + 1024;
+    unsigned char *out = malloc(cap);
+    stream.next_in = (unsigned char *)data;
+    stream.avail_in = len;
+
+    int status = Z_OK;
+    while(status != Z_STREAM_END) {
+        if(stream.total_out == cap) {
+            cap *= 2;
+            out = realloc(out, cap);
+        }
+        stream.next_out = out + stream.total_out;
+        stream.avail_out = cap - stream.total_out;
+        status = inflate(&stream, Z_NO_FLUSH);
+        if(status != Z_OK && status != Z_STREAM_END) break;
+    }
+    *outLen = stream.total_out;
+    inflateEnd(&stream);
+    if(status != Z_STREAM_END) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+static const char tsc_engine_base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+char *tsc_engine_encodeBase64(const unsigned char *data, size_t len, size_t *outLen) {
+    size_t size = 4 * ((len + 2) / 3);
+    char *out = malloc(size + 1);
+    size_t j = 0;
+    for(size_t i = 0; i < len; i += 3) {
+        unsigned int a = data[i];
+        unsigned int b = i + 1 < len ? data[i+1] : 0;
+        unsigned int c = i + 2 < len ? data[i+2] : 0;
+        unsigned int triple = (a << 16) | (b << 8) | c;
+        out[j++] = tsc_engine_base64[(triple >> 18) & 63];
+        out[j++] = tsc_engine_base64[(triple >> 12) & 63];
+        out[j++] = i + 1 < len ? tsc_engine_base64[(triple >> 6) & 63] : '=';
+        out[j++] = i + 2 < len ? tsc_engine_base64[triple & 63] : '=';
+    }
+    out[size] = '\0';
+    *outLen = size;
+    return out;
+}
+
+unsigned char *tsc_engine_decodeBase64(const char *data, size_t *outLen) {
+    static signed char reverse[256];
+    static bool reverseReady = false;
+    if(!reverseReady) {
+        memset(reverse, -1, sizeof(reverse));
+        for(int i = 0; i < 64; i++) reverse[(unsigned char)tsc_engine_base64[i]] = i;
+        reverseReady = true;
+    }
+
+    size_t len = 0;
+    while(data[len] != '\0' && data[len] != '=') len++;
+
+    unsigned char *out = malloc(len * 3 / 4 + 1);
+    size_t j = 0;
+    unsigned int acc = 0;
+    int bits = 0;
+    for(size_t i = 0; i < len; i++) {
+        signed char v = reverse[(unsigned char)data[i]];
+        if(v < 0) continue;
+        acc = (acc << 6) | v;
+        bits += 6;
+        if(bits >= 8) {
+            bits -= 8;
+            out[j++] = (acc >> bits) & 0xFF;
+        }
+    }
+    *outLen = j;
+    return out;
+}
+
+void tsc_engine_free(void *memory) {
+    free(memory);
+}
+
+void tsc_sound_play(const char *id) {
+    // Nobody is listening
+}
+
+#else
+#include <raylib.h>
+
+unsigned char *tsc_engine_compress(const unsigned char *data, size_t len, size_t *outLen) {
+    int compressedLen = 0;
+    unsigned char *compressed = CompressData(data, len, &compressedLen);
+    *outLen = compressedLen;
+    return compressed;
+}
+
+unsigned char *tsc_engine_decompress(const unsigned char *data, size_t len, size_t *outLen) {
+    int decompressedLen = 0;
+    unsigned char *decompressed = DecompressData(data, len, &decompressedLen);
+    *outLen = decompressedLen;
+    return decompressed;
+}
+
+char *tsc_engine_encodeBase64(const unsigned char *data, size_t len, size_t *outLen) {
+    int encodedLen = 0;
+    char *encoded = EncodeDataBase64(data, len, &encodedLen);
+    *outLen = encodedLen;
+    return encoded;
+}
+
+unsigned char *tsc_engine_decodeBase64(const char *data, size_t *outLen) {
+    int decodedLen = 0;
+    unsigned char *decoded = DecodeDataBase64((const unsigned char *)data, &decodedLen);
+    *outLen = decodedLen;
+    return decoded;
+}
+
+void tsc_engine_free(void *memory) {
+    RL_FREE(memory);
+}
+
+#endif
+
+// raylib can only decompress in one go, so the game uses zlib for this too
+#include <zlib.h>
+
+struct tsc_engine_inflater {
+    z_stream stream;
+    bool done;
+};
+
+tsc_engine_inflater *tsc_engine_newInflater() {
+    tsc_engine_inflater *inflater = malloc(sizeof(tsc_engine_inflater));
+    memset(&inflater->stream, 0, sizeof(inflater->stream));
+    inflater->done = inflateInit2(&inflater->stream, -15) != Z_OK;
+    return inflater;
+}
+
+void tsc_engine_feedInflater(tsc_engine_inflater *inflater, const unsigned char *data, size_t len) {
+    // zlib figures out where it ends by itself
+    inflater->stream.next_in = (unsigned char *)data;
+    inflater->stream.avail_in = len;
+}
+
+size_t tsc_engine_inflate(tsc_engine_inflater *inflater, unsigned char *out, size_t cap) {
+    z_stream *stream = &inflater->stream;
+    stream->next_out = out;
+    stream->avail_out = cap;
+    // Some input (like the block headers) gives no output, so keep going until there's output.
+    // zlib can still have output left over after eating all the input, so running out of input doesn't stop this, only Z_BUF_ERROR does.
+    while(!inflater->done && stream->avail_out == cap) {
+        int status = inflate(stream, Z_NO_FLUSH);
+        if(status == Z_BUF_ERROR) break;
+        if(status != Z_OK) inflater->done = true;
+    }
+    return cap - stream->avail_out;
+}
+
+void tsc_engine_freeInflater(tsc_engine_inflater *inflater) {
+    inflateEnd(&inflater->stream);
+    free(inflater);
+}
@@ -0,0 +1,34 @@
+#ifndef TSC_ENGINE_H
+#define TSC_ENGINE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// The thin layer between the engine and whatever it was compiled against.
+// The game implements these with raylib, while TSC_HEADLESS builds use zlib and
+// turn sounds into no-ops, so the engine never needs a window or a GPU context.
+
+// Raw DEFLATE, no zlib header. NULL on failure.
+unsigned char *tsc_engine_compress(const unsigned char *data, size_t len, size_t *outLen);
+unsigned char *tsc_engine_decompress(const unsigned char *data, size_t len, size_t *outLen);
+// Standard base64, with padding. The output is NOT null-terminated.
+char *tsc_engine_encodeBase64(const unsigned char *data, size_t len, size_t *outLen);
+// Stops at the null terminator or the first padding character.
+unsigned char *tsc_engine_decodeBase64(const char *data, size_t *outLen);
+// Must be used on everything returned by the functions above.
+void tsc_engine_free(void *memory);
+
+// Decompresses raw DEFLATE as it's fed in, so nobody needs the whole thing in memory.
+// raylib can only decompress in one go, so this is zlib in the game too.
+typedef struct tsc_engine_inflater tsc_engine_inflater;
+tsc_engine_inflater *tsc_engine_newInflater();
+// The data is read straight from where it is, so it must stay around until tsc_engine_inflate returns 0.
+void tsc_engine_feedInflater(tsc_engine_inflater *inflater, const unsigned char *data, size_t len);
+// Writes up to cap bytes into out. 0 means everything fed so far has been used up, or that the data is over.
+size_t tsc_engine_inflate(tsc_engine_inflater *inflater, unsigned char *out, size_t cap);
+void tsc_engine_freeInflater(tsc_engine_inflater *inflater);
+
+// Implemented by the resources in the game.
+void tsc_sound_play(const char *id);
+
+#endif
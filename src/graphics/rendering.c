@@ -526,20 +526,21 @@ void tsc_drawGrid() {
     if(ey >= currentGrid->height) ey = currentGrid->height-1;
 
     // chunk align
-    sx -= sx % tsc_gridChunkSize;
-    sy -= sy % tsc_gridChunkSize;
+    sx = tsc_grid_chunkOff(currentGrid, sx, 0);
+    sy = tsc_grid_chunkOff(currentGrid, sy, 0);
     if(ex < sx) ex = sx;
     if(ey < sy) ey = sy;
 
     // Debug chunk rendering
     // TODO: debug mode setting
     if(false) {
-        for(int cx = sx; cx < ex; cx += tsc_gridChunkSize) {
-            for(int cy = sy; cy < ey; cy += tsc_gridChunkSize) {
+        int chunkCells = 1 << currentGrid->chunkshift;
+        for(int cx = sx; cx < ex; cx += chunkCells) {
+            for(int cy = sy; cy < ey; cy += chunkCells) {
                 float x = -renderingCamera.x + cx * renderingCamera.cellSize;
                 float y = -renderingCamera.y + cy * renderingCamera.cellSize;
-                Color c = tsc_grid_checkChunk(currentGrid, cx+24, cy+24) ? GREEN : RED;
-                float chunkSize = tsc_gridChunkSize * renderingCamera.cellSize;
+                Color c = tsc_grid_checkChunk(currentGrid, cx, cy) ? GREEN : RED;
+                float chunkSize = chunkCells * renderingCamera.cellSize;
                 DrawRectangleLines(x, y, chunkSize, chunkSize, c);
             }
         }
@@ -572,16 +573,13 @@ void tsc_drawGrid() {
 
 #ifndef TSC_TURBO
     if(storeExtraGraphicInfo) {
-        size_t len = tsc_trashedCellCount;
-        if(len > TSC_MAX_TRASHED) len = TSC_MAX_TRASHED;
+        size_t len;
+        tsc_trashed_cell_t *trashed = tsc_getTrashedCells(&len);
+        float opacity = tsc_updateInterp(1, 0);
         for(size_t i = 0; i < len; i++) {
-            tsc_cell trashed = tsc_trashedCellBuffer[i];
-            int x = (trashed.reg >> 16) & 0xFFFF;
-            int y = (trashed.reg >> 0) & 0xFFFF;
-            trashed.reg = 0; // optional
-            float opacity = tsc_updateInterp(1, 0);
-            tsc_drawCell(&trashed, x, y, opacity, 1, false);
+            tsc_drawCell(&trashed[i].cell, trashed[i].x, trashed[i].y, opacity, 1, false);
         }
+        tsc_releaseTrashedCells();
     }
 #endif
 
@@ -1358,6 +1356,7 @@ void tsc_handleRenderInputs() {
 
     if(IsKeyPressed(KEY_SPACE) && !tsc_renderingIsPasting && !renderingIsSelecting && !renderingIsDragging && !tsc_isResizingGrid) {
         isGamePaused = !isGamePaused;
+        if(multiTickPerFrame) tsc_signalUpdateShouldHappen();
     }
 
     if(IsKeyPressed(KEY_R)) {
@@ -1365,7 +1364,7 @@ void tsc_handleRenderInputs() {
             tsc_saving_decodeWithAny((const char *)initialCode, currentGrid);
             isInitial = true;
             tickCount = 0;
-            tsc_trashedCellCount = 0;
+            tsc_clearTrashedCells();
         }
     }
 
@@ -1389,8 +1388,8 @@ void tsc_handleRenderInputs() {
         onlyOneTick = true;
         if(!multiTickPerFrame) {
             tickTime = 0;
-            tsc_signalUpdateShouldHappen();
         }
+        tsc_signalUpdateShouldHappen();
     }
 
     if(!isGamePaused && !multiTickPerFrame) {
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cells/grid.h"
+#include "cells/subticks.h"
+#include "cells/ticking.h"
+#include "saving/saving.h"
+#include "threads/workers.h"
+#include "utils.h"
+#include "api/api.h"
+
+// tsc-headless, for running levels on machines with no window, GPU or patience.
+// Syntax: tsc-headless --level=<file> [--ticks=N] [--threads=N] [--output=<file>]
+//                      [--format=<saving format>] [--snapshotEvery=N] [--snapshotPrefix=<path>] [--verify]
+
+static void tsc_headless_usage(const char *exe) {
+    fprintf(stderr, "Usage: %s --level=<file> [options]\n", exe);
+    fprintf(stderr, "\t--level=<file> - The level to load. Any supported format works.\n");
+    fprintf(stderr, "\t--code=<code> - Use a level code directly instead of a file.\n");
+    fprintf(stderr, "\t--ticks=N - How many ticks to run (default 100)\n");
+    fprintf(stderr, "\t--threads=N - Worker thread count, same rules as the Thread Count setting\n");
+    fprintf(stderr, "\t--output=<file> - Where to write the final grid\n");
+    fprintf(stderr, "\t--format=<name> - Saving format for outputs (default is the smallest one)\n");
+    fprintf(stderr, "\t--snapshotEvery=N - Write a snapshot every N ticks\n");
+    fprintf(stderr, "\t--snapshotPrefix=<path> - Snapshots are written to <path><tick>.txt (default snapshot_)\n");
+    fprintf(stderr, "\t--verify - Also run every tick serially and stop at the first difference. Very slow.\n");
+}
+
+static bool tsc_headless_write(const char *path, tsc_grid *grid, const char *format) {
+    tsc_buffer buffer = tsc_saving_newBuffer("");
+    if(format == NULL) {
+        tsc_saving_encodeWithSmallest(&buffer, grid);
+    } else if(!tsc_saving_encodeWith(&buffer, grid, format)) {
+        buffer.len = 0;
+    }
+    if(buffer.len == 0) {
+        fprintf(stderr, "Error: unable to encode grid%s%s\n", format == NULL ? "" : " with ", format == NULL ? "" : format);
+        tsc_saving_deleteBuffer(buffer);
+        return false;
+    }
+    FILE *f = fopen(path, "w");
+    if(f == NULL) {
+        fprintf(stderr, "Error: unable to open %s\n", path);
+        tsc_saving_deleteBuffer(buffer);
+        return false;
+    }
+    fwrite(buffer.mem, sizeof(char), buffer.len, f);
+    fclose(f);
+    tsc_saving_deleteBuffer(buffer);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    srand(time(NULL));
+
+    const char *levelPath = NULL;
+    const char *levelCode = NULL;
+    const char *output = NULL;
+    const char *format = NULL;
+    const char *snapshotPrefix = "snapshot_";
+    size_t ticks = 100;
+    size_t snapshotEvery = 0;
+    const char *threads = NULL;
+    bool verify = false;
+
+    for(int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        if(strncmp(arg, "--level=", 8) == 0) {
+            levelPath = arg + 8;
+        } else if(strncmp(arg, "--code=", 7) == 0) {
+            levelCode = arg + 7;
+        } else if(strncmp(arg, "--ticks=", 8) == 0) {
+            ticks = strtoull(arg + 8, NULL, 10);
+        } else if(strncmp(arg, "--threads=", 10) == 0) {
+            threads = arg + 10;
+        } else if(strncmp(arg, "--output=", 9) == 0) {
+            output = arg + 9;
+        } else if(strncmp(arg, "--format=", 9) == 0) {
+            format = arg + 9;
+        } else if(strncmp(arg, "--snapshotEvery=", 16) == 0) {
+            snapshotEvery = strtoull(arg + 16, NULL, 10);
+        } else if(strncmp(arg, "--snapshotPrefix=", 17) == 0) {
+            snapshotPrefix = arg + 17;
+        } else if(strcmp(arg, "--verify") == 0) {
+            verify = true;
+        } else {
+            tsc_headless_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if(levelPath == NULL && levelCode == NULL) {
+        tsc_headless_usage(argv[0]);
+        return 1;
+    }
+
+    char *levelFile = NULL;
+    if(levelCode == NULL) {
+        levelFile = tsc_allocfile(levelPath, NULL);
+        if(levelFile == NULL) {
+            fprintf(stderr, "Error: unable to read %s\n", levelPath);
+            return 1;
+        }
+        levelCode = levelFile;
+    }
+
+    workers_setupBest();
+
+    tsc_init_builtin_ids();
+    tsc_subtick_addCore();
+    tsc_saving_registerCore();
+    tsc_loadSettings();
+
+    // Nobody is going to look at the particles
+    storeExtraGraphicInfo = false;
+
+    if(threads != NULL) {
+        workers_setAmount(atoi(threads));
+    }
+
+    if(tsc_saving_identify(levelCode) == NULL) {
+        fprintf(stderr, "Error: unknown level format\n");
+        return 1;
+    }
+
+    tsc_grid *grid = tsc_createGrid("main", 100, 100, NULL, NULL);
+    double loadStart = tsc_clock();
+    tsc_saving_decodeWithAny(levelCode, grid);
+    double loadEnd = tsc_clock();
+    tsc_switchGrid(grid);
+    tsc_freefile(levelFile);
+
+    fprintf(stderr, "Loaded %dx%d grid in %.3fs\n", grid->width, grid->height, loadEnd - loadStart);
+
+    double start = tsc_clock();
+    for(size_t i = 0; i < ticks; i++) {
+        if(verify) {
+            tsc_subtick_divergence_t divergence;
+            if(!tsc_subtick_runVerified(&divergence)) {
+                fprintf(stderr, "Error: tick %lu diverged from the serial run after %s at %d,%d (%lu cells differ, %lu conflicts)\n",
+                    (unsigned long)tickCount, divergence.subtick, divergence.x, divergence.y, (unsigned long)divergence.cells,
+                    (unsigned long)divergence.conflicts);
+                if(output != NULL) tsc_headless_write(output, currentGrid, format);
+                return 2;
+            }
+        } else {
+            tsc_subtick_run();
+        }
+        tickCount++;
+        if(snapshotEvery != 0 && tickCount % snapshotEvery == 0) {
+            const char *path = tsc_tsprintf("%s%lu.txt", snapshotPrefix, (unsigned long)tickCount);
+            if(!tsc_headless_write(path, currentGrid, format)) return 1;
+            tsc_areset(&tsc_tmp);
+        }
+    }
+    double end = tsc_clock();
+
+    double elapsed = end - start;
+    fprintf(stderr, "Ran %lu ticks in %.3fs (%.2f TPS) on %d threads\n", (unsigned long)ticks, elapsed, elapsed > 0 ? ticks / elapsed : 0, workers_amount());
+
+    if(output != NULL) {
+        if(!tsc_headless_write(output, currentGrid, format)) return 1;
+    }
+
+    return 0;
+}
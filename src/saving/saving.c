@@ -10,7 +10,7 @@
 #include "../api/value.h"
 #include "../api/api.h"
 #include "../threads/workers.h"
-#include <raylib.h>
+#include "../engine.h"
 #include <assert.h>
 
 static tsc_saving_format *saving_arr = NULL;
@@ -725,6 +725,11 @@ typedef struct tsc_tsc_state {
     unsigned int (*encoder)(tsc_buffer *buffer, tsc_grid *grid, int idx, int len);
     // never fail
     size_t (*decoder)(tsc_grid *grid, char *data, size_t *idx);
+    // What the streaming decoder needs to cut records out: how many bytes the count takes up,
+    // whether it's followed by 2 cells per byte and whether those are on placeables
+    int numSize;
+    bool packed;
+    bool placeable;
 } tsc_tsc_state;
 
 static unsigned int tsc_tsc_encodeEmpties(tsc_buffer *buffer, tsc_grid *grid, int idx, int len, int numSize, tsc_id_t bg) {
@@ -938,13 +943,8 @@ static unsigned int tsc_tsc_encodeVanillaBigBrainOpt(tsc_buffer *buffer, tsc_gri
     return cellCount;
 }
 
-static size_t tsc_tsc_decodeVanillaBigBrainOpt(tsc_grid *grid, char *data, size_t *cellIdx, tsc_id_t bg, int numSize) {
-    size_t cellCount = 0;
-    for(int i = 0; i < numSize; i++) {
-        size_t dataByte = (unsigned char)data[i];
-        cellCount |= (dataByte << (i * 8));
-    }
-    
+// Decodes cellCount cells packed 2 per byte, without the count in front
+static void tsc_tsc_decodeVanillaCells(tsc_grid *grid, char *data, size_t *cellIdx, size_t cellCount, tsc_id_t bg) {
     tsc_tsc_vanillaTableEntry table[16] = {
         // Super optimized 4-bit encoding
         // This simplifies cells, which technically makes the TSC format not lossless,
@@ -967,9 +967,6 @@ static size_t tsc_tsc_decodeVanillaBigBrainOpt(tsc_grid *grid, char *data, size_
         {0b1111, builtin.rotator_ccw, 0},
     };
 
-    data += numSize;
-
-    size_t byteLen = cellCount / 2 + (cellCount & 1);
     for(size_t i = 0; i < cellCount; i++) {
         char cellBits = (data[i / 2] >> ((i % 2) * 4)) & 0xF;
         size_t j = (*cellIdx) + i;
@@ -980,6 +977,18 @@ static size_t tsc_tsc_decodeVanillaBigBrainOpt(tsc_grid *grid, char *data, size_
     }
 
     (*cellIdx) += cellCount;
+}
+
+static size_t tsc_tsc_decodeVanillaBigBrainOpt(tsc_grid *grid, char *data, size_t *cellIdx, tsc_id_t bg, int numSize) {
+    size_t cellCount = 0;
+    for(int i = 0; i < numSize; i++) {
+        size_t dataByte = (unsigned char)data[i];
+        cellCount |= (dataByte << (i * 8));
+    }
+
+    tsc_tsc_decodeVanillaCells(grid, data + numSize, cellIdx, cellCount, bg);
+
+    size_t byteLen = cellCount / 2 + (cellCount & 1);
     return numSize + byteLen;
 }
 
@@ -1049,22 +1058,22 @@ static size_t tsc_tsc_decodeVanillaWithPlace4(tsc_grid *grid, char *data, size_t
 
 #define TSC_TSC_STATECOUNT 16
 static tsc_tsc_state tsc_tsc_states[TSC_TSC_STATECOUNT] = {
-    {'A', tsc_tsc_encodeEmpties1, tsc_tsc_decodeEmpties1},
-    {'B', tsc_tsc_encodeEmpties2, tsc_tsc_decodeEmpties2},
-    {'C', tsc_tsc_encodeEmpties3, tsc_tsc_decodeEmpties3},
-    {'D', tsc_tsc_encodeEmpties4, tsc_tsc_decodeEmpties4},
-    {'1', tsc_tsc_encodePlaces1, tsc_tsc_decodePlaces1},
-    {'2', tsc_tsc_encodePlaces2, tsc_tsc_decodePlaces2},
-    {'3', tsc_tsc_encodePlaces3, tsc_tsc_decodePlaces3},
-    {'4', tsc_tsc_encodePlaces4, tsc_tsc_decodePlaces4},
-    {'E', tsc_tsc_encodeVanillaNoPlace1, tsc_tsc_decodeVanillaNoPlace1},
-    {'F', tsc_tsc_encodeVanillaWithPlace1, tsc_tsc_decodeVanillaWithPlace1},
-    {'G', tsc_tsc_encodeVanillaNoPlace2, tsc_tsc_decodeVanillaNoPlace2},
-    {'H', tsc_tsc_encodeVanillaWithPlace2, tsc_tsc_decodeVanillaWithPlace2},
-    {'I', tsc_tsc_encodeVanillaNoPlace3, tsc_tsc_decodeVanillaNoPlace3},
-    {'J', tsc_tsc_encodeVanillaWithPlace3, tsc_tsc_decodeVanillaWithPlace3},
-    {'K', tsc_tsc_encodeVanillaNoPlace4, tsc_tsc_decodeVanillaNoPlace4},
-    {'L', tsc_tsc_encodeVanillaWithPlace4, tsc_tsc_decodeVanillaWithPlace4},
+    {'A', tsc_tsc_encodeEmpties1, tsc_tsc_decodeEmpties1, 1, false, false},
+    {'B', tsc_tsc_encodeEmpties2, tsc_tsc_decodeEmpties2, 2, false, false},
+    {'C', tsc_tsc_encodeEmpties3, tsc_tsc_decodeEmpties3, 3, false, false},
+    {'D', tsc_tsc_encodeEmpties4, tsc_tsc_decodeEmpties4, 4, false, false},
+    {'1', tsc_tsc_encodePlaces1, tsc_tsc_decodePlaces1, 1, false, true},
+    {'2', tsc_tsc_encodePlaces2, tsc_tsc_decodePlaces2, 2, false, true},
+    {'3', tsc_tsc_encodePlaces3, tsc_tsc_decodePlaces3, 3, false, true},
+    {'4', tsc_tsc_encodePlaces4, tsc_tsc_decodePlaces4, 4, false, true},
+    {'E', tsc_tsc_encodeVanillaNoPlace1, tsc_tsc_decodeVanillaNoPlace1, 1, true, false},
+    {'F', tsc_tsc_encodeVanillaWithPlace1, tsc_tsc_decodeVanillaWithPlace1, 1, true, true},
+    {'G', tsc_tsc_encodeVanillaNoPlace2, tsc_tsc_decodeVanillaNoPlace2, 2, true, false},
+    {'H', tsc_tsc_encodeVanillaWithPlace2, tsc_tsc_decodeVanillaWithPlace2, 2, true, true},
+    {'I', tsc_tsc_encodeVanillaNoPlace3, tsc_tsc_decodeVanillaNoPlace3, 3, true, false},
+    {'J', tsc_tsc_encodeVanillaWithPlace3, tsc_tsc_decodeVanillaWithPlace3, 3, true, true},
+    {'K', tsc_tsc_encodeVanillaNoPlace4, tsc_tsc_decodeVanillaNoPlace4, 4, true, false},
+    {'L', tsc_tsc_encodeVanillaWithPlace4, tsc_tsc_decodeVanillaWithPlace4, 4, true, true},
 };
 
 typedef struct tsc_tsc_chunk {
@@ -1072,6 +1081,9 @@ typedef struct tsc_tsc_chunk {
     tsc_buffer buffer;
     int start;
     int len;
+    // Only used by TSC2, where every chunk is compressed on its own
+    char *base64;
+    size_t base64Len;
 } tsc_tsc_chunk;
 
 void tsc_tsc_encodeChunk(tsc_tsc_chunk *chunk) {
@@ -1169,30 +1181,159 @@ int tsc_tsc_encode(tsc_buffer *buffer, tsc_grid *grid) {
         return 0; // we failed.... somehow
     }
 
-    int deflatedLen;
-    unsigned char *deflated = CompressData((unsigned char *)finalData.mem, finalData.len, &deflatedLen); // get deflated
+    size_t deflatedLen;
+    unsigned char *deflated = tsc_engine_compress((unsigned char *)finalData.mem, finalData.len, &deflatedLen); // get deflated
+    tsc_saving_deleteBuffer(finalData);
 
-    int base64Len;
-    char *based64 = EncodeDataBase64(deflated, deflatedLen, &base64Len);
-    RL_FREE(deflated);
+    size_t base64Len;
+    char *based64 = tsc_engine_encodeBase64(deflated, deflatedLen, &base64Len);
+    tsc_engine_free(deflated);
 
     tsc_saving_writeBytes(buffer, based64, base64Len);
 
-    RL_FREE(based64);
+    tsc_engine_free(based64);
     
     tsc_saving_write(buffer, ';');
 
     return 1;
 }
 
-size_t tsc_tsc_decodeChunk(tsc_grid *grid, size_t *cellIdx, char *data, char format) {
+static tsc_tsc_state *tsc_tsc_findState(char format) {
     for(size_t i = 0; i < TSC_TSC_STATECOUNT; i++) {
-        tsc_tsc_state state = tsc_tsc_states[i];
-        if(state.headerByte == format) {
-            return state.decoder(grid, data, cellIdx);
+        if(tsc_tsc_states[i].headerByte == format) return tsc_tsc_states + i;
+    }
+    return NULL;
+}
+
+size_t tsc_tsc_decodeChunk(tsc_grid *grid, size_t *cellIdx, char *data, char format) {
+    tsc_tsc_state *state = tsc_tsc_findState(format);
+    if(state == NULL) return 0; // unsupported, REALLY BAD
+    return state->decoder(grid, data, cellIdx);
+}
+
+// Goes from the base64 in the code to decompressed bytes a window at a time, so the whole thing never has to be in memory
+typedef struct tsc_tsc_stream {
+    const char *base64;
+    size_t base64Len;
+    size_t base64Read;
+    unsigned int acc;
+    int bits;
+    unsigned char *compressed;
+    tsc_engine_inflater *inflater;
+    bool fedAll;
+    unsigned char *window;
+    size_t len;
+    size_t pos;
+} tsc_tsc_stream;
+
+// No lookup table, since several chunks can be decoded at once
+static int tsc_tsc_base64Value(char c) {
+    if(c >= 'A' && c <= 'Z') return c - 'A';
+    if(c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if(c >= '0' && c <= '9') return c - '0' + 52;
+    if(c == '+') return 62;
+    if(c == '/') return 63;
+    return -1;
+}
+
+// Decodes up to a window of base64 into stream->compressed
+static size_t tsc_tsc_unbase64(tsc_tsc_stream *stream) {
+
+    size_t end = stream->base64Read + TSC_TSC_WINDOW;
+    if(end > stream->base64Len) end = stream->base64Len;
+    size_t j = 0;
+    for(size_t i = stream->base64Read; i < end; i++) {
+        char c = stream->base64[i];
+        if(c == '=') {
+            // Padding is always at the end
+            end = stream->base64Len;
+            break;
+        }
+        int v = tsc_tsc_base64Value(c);
+        if(v < 0) continue;
+        stream->acc = (stream->acc << 6) | v;
+        stream->bits += 6;
+        if(stream->bits >= 8) {
+            stream->bits -= 8;
+            stream->compressed[j++] = (stream->acc >> stream->bits) & 0xFF;
+        }
+    }
+    stream->base64Read = end;
+    return j;
+}
+
+// Makes sure at least n bytes (n being at most TSC_TSC_WINDOW) are in the window after pos. False if the data ends first.
+static bool tsc_tsc_need(tsc_tsc_stream *stream, size_t n) {
+    if(stream->len - stream->pos >= n) return true;
+    memmove(stream->window, stream->window + stream->pos, stream->len - stream->pos);
+    stream->len -= stream->pos;
+    stream->pos = 0;
+    while(stream->len < n) {
+        size_t got = tsc_engine_inflate(stream->inflater, stream->window + stream->len, TSC_TSC_WINDOW - stream->len);
+        if(got > 0) {
+            stream->len += got;
+            continue;
         }
+        if(stream->fedAll) return false;
+        size_t compressedLen = tsc_tsc_unbase64(stream);
+        stream->fedAll = stream->base64Read == stream->base64Len;
+        tsc_engine_feedInflater(stream->inflater, stream->compressed, compressedLen);
     }
-    return 0; // unsupported, REALLY BAD
+    return true;
+}
+
+// Decodes the records straight out of the window into the cells from cellIdx up to (but excluding) end.
+// Vanilla records too big for the window get decoded a window at a time.
+static void tsc_tsc_decodeStream(tsc_tsc_stream *stream, tsc_grid *grid, size_t cellIdx, size_t end) {
+    while(cellIdx < end) {
+        if(!tsc_tsc_need(stream, 1)) return;
+        tsc_tsc_state *state = tsc_tsc_findState(stream->window[stream->pos]);
+        if(state == NULL) return; // unsupported, REALLY BAD
+        stream->pos++;
+
+        if(!tsc_tsc_need(stream, state->numSize)) return;
+        size_t count = 0;
+        for(int i = 0; i < state->numSize; i++) {
+            count |= (size_t)stream->window[stream->pos + i] << (i * 8);
+        }
+        // Broken codes shouldn't write past the grid (or into another chunk's cells)
+        size_t cells = state->packed ? count : count + 1;
+        if(cells > end - cellIdx) return;
+
+        size_t size = state->numSize + (state->packed ? count / 2 + (count & 1) : 0);
+        if(size <= TSC_TSC_WINDOW) {
+            if(!tsc_tsc_need(stream, size)) return;
+            stream->pos += state->decoder(grid, (char *)stream->window + stream->pos, &cellIdx);
+            continue;
+        }
+
+        stream->pos += state->numSize;
+        tsc_id_t bg = state->placeable ? builtin.placeable : builtin.empty;
+        while(count > 0) {
+            // Even, so pieces never split a byte
+            size_t piece = count;
+            if(piece > TSC_TSC_WINDOW * 2) piece = TSC_TSC_WINDOW * 2;
+            size_t bytes = piece / 2 + (piece & 1);
+            if(!tsc_tsc_need(stream, bytes)) return;
+            tsc_tsc_decodeVanillaCells(grid, (char *)stream->window + stream->pos, &cellIdx, piece, bg);
+            stream->pos += bytes;
+            count -= piece;
+        }
+    }
+}
+
+// Decodes one deflated, base64'd run of records into the cells from start up to (but excluding) end
+static void tsc_tsc_decodeBase64(const char *base64, size_t base64Len, tsc_grid *grid, size_t start, size_t end) {
+    tsc_tsc_stream stream = {base64, base64Len, 0, 0, 0, NULL, NULL, false, NULL, 0, 0};
+    stream.compressed = malloc(TSC_TSC_WINDOW);
+    stream.window = malloc(TSC_TSC_WINDOW);
+    stream.inflater = tsc_engine_newInflater();
+
+    tsc_tsc_decodeStream(&stream, grid, start, end);
+
+    tsc_engine_freeInflater(stream.inflater);
+    free(stream.compressed);
+    free(stream.window);
 }
 
 void tsc_tsc_decode(const char *code, tsc_grid *grid) {
@@ -1209,35 +1350,159 @@ void tsc_tsc_decode(const char *code, tsc_grid *grid) {
     
     tsc_clearGrid(grid, width, height);
 
-    size_t cellIdx = 0;
     size_t area = width * height;
 
-    clock_t start = clock();
-    unsigned char *eBase64 = (void *)tsc_v3_nextPart(code, &index);
-    int deflatedLen;
-    unsigned char *deflated = DecodeDataBase64(eBase64, &deflatedLen);
-
-    int encodedLen;
-    char *encodedData = (void *)DecompressData(deflated, deflatedLen, &encodedLen);
-    char *startOfData = encodedData;
-    clock_t decompressed = clock();
-
-    while(cellIdx < area) {
-        char header = *encodedData;
-        encodedData++;
-        size_t readData = tsc_tsc_decodeChunk(grid, &cellIdx, encodedData, header);
-        encodedData += readData;
+    // The base64 is read right out of the code, up to the next ;
+    const char *base64 = code + index;
+    const char *base64End = strchr(base64, ';');
+    size_t base64Len = base64End == NULL ? strlen(base64) : (size_t)(base64End - base64);
+
+    tsc_tsc_decodeBase64(base64, base64Len, grid, 0, area);
+}
+
+// TSC2 is TSC, but split into chunks which are compressed on their own, with an index in front so they can be decoded at the same time.
+// TSC2;<width>;<height>;<chunk count>;<first cell>,<base64 length>,<first cell>,<base64 length>...;<base64>;<base64>...;
+// Everything but the base64 is in base 74, and chunks cover the cells from their first cell up to the next chunk's.
+
+static void tsc_tsc2_encodeChunk(tsc_tsc_chunk *chunk) {
+    tsc_tsc_encodeChunk(chunk);
+    chunk->base64 = NULL;
+    chunk->base64Len = 0;
+    if(chunk->buffer.len == 0) return;
+    size_t deflatedLen;
+    unsigned char *deflated = tsc_engine_compress((unsigned char *)chunk->buffer.mem, chunk->buffer.len, &deflatedLen);
+    if(deflated == NULL) return;
+    chunk->base64 = tsc_engine_encodeBase64(deflated, deflatedLen, &chunk->base64Len);
+    tsc_engine_free(deflated);
+}
+
+int tsc_tsc2_encode(tsc_buffer *buffer, tsc_grid *grid) {
+    int area = grid->width * grid->height;
+    // Doesn't depend on the thread count, since whoever loads it might have more
+    int perChunk = area / TSC_TSC2_MAXCHUNKS;
+    if(perChunk < TSC_TSC2_MINCHUNK) perChunk = TSC_TSC2_MINCHUNK;
+
+    int chunkc = 0;
+    tsc_tsc_chunk *chunks = malloc(sizeof(chunks[0]) * (1 + area / perChunk));
+    for(int consumed = 0; consumed < area; consumed += perChunk) {
+        int len = area - consumed;
+        if(len > perChunk) len = perChunk;
+        tsc_tsc_chunk chunk = {grid, tsc_saving_newBufferCapacity(NULL, 8192), consumed, len};
+        chunks[chunkc++] = chunk;
+    }
+
+    workers_waitForTasksFlat((worker_task_t *)&tsc_tsc2_encodeChunk, chunks, sizeof(tsc_tsc_chunk), chunkc);
+
+    bool failed = false;
+    for(int i = 0; i < chunkc; i++) {
+        if(chunks[i].base64 == NULL) failed = true;
+    }
+
+    if(!failed) {
+        tsc_saving_writeStr(buffer, "TSC2;");
+        char *ewidth = tsc_saving_encode74(grid->width);
+        char *eheight = tsc_saving_encode74(grid->height);
+        char *echunkc = tsc_saving_encode74(chunkc);
+        tsc_saving_writeFormat(buffer, "%s;%s;%s;", ewidth, eheight, echunkc);
+        free(ewidth);
+        free(eheight);
+        free(echunkc);
+
+        for(int i = 0; i < chunkc; i++) {
+            char *estart = tsc_saving_encode74(chunks[i].start);
+            char *elen = tsc_saving_encode74(chunks[i].base64Len);
+            tsc_saving_writeFormat(buffer, "%s,%s,", estart, elen);
+            free(estart);
+            free(elen);
+        }
+        tsc_saving_write(buffer, ';');
+
+        for(int i = 0; i < chunkc; i++) {
+            tsc_saving_writeBytes(buffer, chunks[i].base64, chunks[i].base64Len);
+            tsc_saving_write(buffer, ';');
+        }
+    }
+
+    for(int i = 0; i < chunkc; i++) {
+        tsc_saving_deleteBuffer(chunks[i].buffer);
+        if(chunks[i].base64 != NULL) tsc_engine_free(chunks[i].base64);
+    }
+    free(chunks);
+
+    if(failed) {
+        fprintf(stderr, "TSC2 format somehow failed. Bad mod?\n");
+        return 0;
     }
+    return 1;
+}
+
+typedef struct tsc_tsc2_part {
+    tsc_grid *grid;
+    const char *base64;
+    size_t base64Len;
+    size_t start;
+    size_t end;
+} tsc_tsc2_part;
+
+static void tsc_tsc2_decodePart(tsc_tsc2_part *part) {
+    tsc_tsc_decodeBase64(part->base64, part->base64Len, part->grid, part->start, part->end);
+}
 
-    clock_t decoded = clock();
+void tsc_tsc2_decode(const char *code, tsc_grid *grid) {
+    size_t index = 5; // after TSC2;
 
-    printf("Timings\n");
-    printf("Decompress: %f\n", (float)(decompressed - start) / CLOCKS_PER_SEC);
-    printf("Decode: %f\n", (float)(decoded - decompressed) / CLOCKS_PER_SEC);
+    char *ewidth = tsc_v3_nextPart(code, &index);
+    char *eheight = tsc_v3_nextPart(code, &index);
+    char *echunkc = tsc_v3_nextPart(code, &index);
+
+    int width = tsc_saving_decode74(ewidth);
+    int height = tsc_saving_decode74(eheight);
+    size_t chunkc = tsc_saving_decode74(echunkc);
 
-    free(eBase64);
-    RL_FREE(deflated);
-    RL_FREE(startOfData);
+    free(ewidth);
+    free(eheight);
+    free(echunkc);
+
+    tsc_clearGrid(grid, width, height);
+    size_t area = width * height;
+
+    char *header = tsc_v3_nextPart(code, &index);
+    size_t codeLen = strlen(code);
+    // Every entry takes at least 4 characters, so a broken count can't make us allocate a ton
+    size_t maxChunks = strlen(header) / 4 + 1;
+    if(chunkc > maxChunks) chunkc = maxChunks;
+    tsc_tsc2_part *parts = malloc(sizeof(tsc_tsc2_part) * (chunkc + 1));
+    size_t partc = 0;
+    size_t headerIdx = 0;
+    size_t offset = index;
+    for(size_t i = 0; i < chunkc; i++) {
+        char *estart = tsc_v3_nextPartUntil(header, &headerIdx, ',');
+        char *elen = tsc_v3_nextPartUntil(header, &headerIdx, ',');
+        if(estart == NULL || elen == NULL) {
+            free(estart);
+            free(elen);
+            break;
+        }
+        size_t cellStart = tsc_saving_decode74(estart);
+        size_t len = tsc_saving_decode74(elen);
+        free(estart);
+        free(elen);
+        // A broken index gets us as far as it's right
+        if(offset + len > codeLen) break;
+        if(cellStart > area) break;
+        if(partc > 0 && cellStart < parts[partc - 1].start) break;
+        tsc_tsc2_part part = {grid, code + offset, len, cellStart, area};
+        if(partc > 0) parts[partc - 1].end = cellStart;
+        parts[partc++] = part;
+        offset += len + 1;
+    }
+    free(header);
+    if(partc < chunkc) {
+        fprintf(stderr, "TSC2 index is broken, only loaded %zu of %zu chunks\n", partc, chunkc);
+    }
+
+    workers_waitForTasksFlat((worker_task_t *)&tsc_tsc2_decodePart, parts, sizeof(tsc_tsc2_part), partc);
+    free(parts);
 }
 
 void tsc_saving_register(tsc_saving_format format) {
@@ -1278,6 +1543,14 @@ void tsc_saving_registerCore() {
     tsc.encode = tsc_tsc_encode;
     tsc.flags = 0;
     tsc_saving_register(tsc);
+
+    tsc_saving_format tsc2 = {};
+    tsc2.name = "TSC2";
+    tsc2.header = "TSC2;";
+    tsc2.decode = tsc_tsc2_decode;
+    tsc2.encode = tsc_tsc2_encode;
+    tsc2.flags = 0;
+    tsc_saving_register(tsc2);
 }
 
 char *tsc_saving_safeFast(tsc_grid *grid) {
@@ -28,6 +28,14 @@ typedef void tsc_saving_decoder(const char *code, tsc_grid *grid);
 
 #define TSC_SAVING_COMPATIBILITY 1
 
+// hideapi
+// How much decompressed data TSC decoding keeps around at once
+#define TSC_TSC_WINDOW 65536
+// TSC2 chunks are big enough that compressing them on their own barely costs anything
+#define TSC_TSC2_MINCHUNK 65536
+#define TSC_TSC2_MAXCHUNKS 64
+// hideapi
+
 typedef struct tsc_saving_format {
     const char *name;
     const char *header;
@@ -1,43 +1,238 @@
 #include "saving.h"
 #include "../testing.h"
+#include "../engine.h"
 #include "test_saving.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
-void tsc_testSaving() {
+// Deterministic, so a failure can actually be reproduced
+static uint32_t tsc_testSaving_seed = 0;
+
+static uint32_t tsc_testSaving_random() {
+    tsc_testSaving_seed = tsc_testSaving_seed * 1664525 + 1013904223;
+    return tsc_testSaving_seed >> 8;
+}
+
+// What each nibble of a vanilla run means, same as the TSC decoder
+static void tsc_testSaving_vanilla(int bits, tsc_id_t *id, char *rot) {
+    *rot = 0;
+    if(bits < 4) {
+        *id = builtin.generator;
+        *rot = bits;
+    } else if(bits < 8) {
+        *id = builtin.mover;
+        *rot = bits - 4;
+    } else if(bits < 10) {
+        *id = builtin.slide;
+        *rot = bits - 8;
+    } else {
+        tsc_id_t rest[] = {builtin.push, builtin.wall, builtin.enemy, builtin.trash, builtin.rotator_cw, builtin.rotator_ccw};
+        *id = rest[bits - 10];
+    }
+}
+
+// Only cells TSC can store exactly, with some placeables and empty areas thrown in
+static tsc_grid *tsc_testSaving_randomGrid(const char *name, int width, int height) {
+    tsc_grid *grid = tsc_createGrid(name, width, height, NULL, NULL);
+    for(int y = 0; y < height; y++) {
+        for(int x = 0; x < width; x++) {
+            uint32_t r = tsc_testSaving_random();
+            // Whole stretches of empties, so the other records get used too
+            if((x / 50 + y / 20) % 3 == 0) continue;
+            if(r % 8 == 0) {
+                tsc_cell place = tsc_cell_create(builtin.placeable, 0);
+                tsc_grid_setBackground(grid, x, y, &place);
+            }
+            if(r % 5 == 0) continue;
+            tsc_id_t id;
+            char rot;
+            tsc_testSaving_vanilla((r >> 4) % 16, &id, &rot);
+            tsc_cell cell = tsc_cell_create(id, rot);
+            tsc_grid_set(grid, x, y, &cell);
+        }
+    }
+    return grid;
+}
+
+// Checks the cells from start up to (but excluding) end and only reports the first mismatch, so a broken decoder doesn't spam a million lines
+static bool tsc_testSaving_compare(const char *what, tsc_grid *grid, tsc_grid *out, size_t start, size_t end) {
+    for(size_t i = start; i < end; i++) {
+        int x = i % grid->width;
+        int y = i / grid->width;
+        tsc_cell *a = tsc_grid_get(grid, x, y);
+        tsc_cell *b = tsc_grid_get(out, x, y);
+        tsc_cell *abg = tsc_grid_background(grid, x, y);
+        tsc_cell *bbg = tsc_grid_background(out, x, y);
+        if(a->id != b->id || tsc_cell_getRotation(a) != tsc_cell_getRotation(b) || abg->id != bbg->id) {
+            tsc_fail("%s: at %d,%d cell %d (rot %d, bg %d) became %d (rot %d, bg %d)", what, x, y,
+                a->id, tsc_cell_getRotation(a), abg->id, b->id, tsc_cell_getRotation(b), bbg->id);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool tsc_testSaving_isEmpty(const char *what, tsc_grid *grid, size_t start, size_t end) {
+    for(size_t i = start; i < end; i++) {
+        int x = i % grid->width;
+        int y = i / grid->width;
+        if(tsc_grid_get(grid, x, y)->id != builtin.empty || tsc_grid_background(grid, x, y)->id != builtin.empty) {
+            tsc_fail("%s: at %d,%d there should be nothing", what, x, y);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void tsc_testSaving_roundTrip(tsc_grid *grid, const char *format) {
+    tsc_grid *out = tsc_createGrid("out", 1, 1, NULL, NULL);
+    tsc_saving_buffer buffer = tsc_saving_newBuffer(NULL);
+    tsc_assert(tsc_saving_encodeWith(&buffer, grid, format) == true, "%s encoding failed", format);
+    tsc_saving_decodeWith(buffer.mem, out, format);
+    tsc_saving_deleteBuffer(buffer);
+
+    tsc_assert(grid->width == out->width, "%s: width went from %d to %d", format, grid->width, out->width);
+    tsc_assert(grid->height == out->height, "%s: height went from %d to %d", format, grid->height, out->height);
+    if(grid->width == out->width && grid->height == out->height) {
+        tsc_testSaving_compare(format, grid, out, 0, (size_t)grid->width * grid->height);
+    }
+    tsc_deleteGrid(out);
+}
+
+static void tsc_testSaving_v3() {
     tsc_test("Encoding V3");
     tsc_grid *grid = tsc_createGrid("test", 100, 100, NULL, NULL);
 
     tsc_cell cell = tsc_cell_create(builtin.generator, 3);
     tsc_grid_set(grid, 50, 50, &cell);
-    cell.rot = 0;
+    cell = tsc_cell_create(builtin.generator, 0);
     tsc_grid_set(grid, 51, 50, &cell);
-    cell.rot = 1;
+    cell = tsc_cell_create(builtin.generator, 1);
     tsc_grid_set(grid, 51, 51, &cell);
-    cell.rot = 2;
+    cell = tsc_cell_create(builtin.generator, 2);
     tsc_grid_set(grid, 50, 51, &cell);
-    cell.id = builtin.rotator_ccw;
-    cell.rot = 0;
+    cell = tsc_cell_create(builtin.rotator_ccw, 0);
     tsc_grid_set(grid, 52, 52, &cell);
 
-    tsc_grid *out = tsc_createGrid("out", 1, 1, NULL, NULL);
+    tsc_testSaving_roundTrip(grid, "V3");
+    tsc_deleteGrid(grid);
+}
+
+static void tsc_testSaving_tsc() {
+    tsc_test("Encoding TSC and TSC2");
+    // Over TSC_TSC2_MINCHUNK * 3 cells, so TSC2 splits it into several chunks
+    int width = 500;
+    int height = TSC_TSC2_MINCHUNK * 3 / width + 7;
+    tsc_grid *grid = tsc_testSaving_randomGrid("test", width, height);
+    tsc_testSaving_roundTrip(grid, "TSC");
+    tsc_testSaving_roundTrip(grid, "TSC2");
+
+    tsc_test("Decoding broken TSC2 indexes");
     tsc_saving_buffer buffer = tsc_saving_newBuffer(NULL);
-    tsc_assert(tsc_saving_encodeWith(&buffer, grid, "V3") == true, "V3 encoding failed");
-    tsc_saving_decodeWith(buffer.mem, out, "V3");
+    tsc_saving_encodeWith(&buffer, grid, "TSC2");
+    size_t area = (size_t)width * height;
+
+    // TSC2;<width>;<height>;<chunk count>;<index>;<base64>;<base64>...;
+    const char *chunkc = buffer.mem + 5;
+    for(int i = 0; i < 2; i++) chunkc = strchr(chunkc, ';') + 1;
+    const char *index = strchr(chunkc, ';') + 1;
+    const char *firstChunk = strchr(index, ';') + 1;
+    const char *secondChunk = strchr(firstChunk, ';') + 1;
+    tsc_grid *out = tsc_createGrid("out", 1, 1, NULL, NULL);
+
+    // Cut off halfway through the second chunk. The first one is still fine, and nothing past it should be made up
+    size_t cut = (secondChunk - buffer.mem) + 10;
+    char *truncated = malloc(cut + 1);
+    memcpy(truncated, buffer.mem, cut);
+    truncated[cut] = '\0';
+    tsc_saving_decodeWith(truncated, out, "TSC2");
+    free(truncated);
+    tsc_assert(out->width == width && out->height == height, "truncated TSC2 is %dx%d, not %dx%d", out->width, out->height, width, height);
+    if(out->width == width && out->height == height) {
+        tsc_testSaving_compare("truncated TSC2", grid, out, 0, TSC_TSC2_MINCHUNK);
+        tsc_testSaving_isEmpty("truncated TSC2", out, TSC_TSC2_MINCHUNK, area);
+    }
+
+    // A garbage chunk count, way more than the index has. It should just load what is there instead of allocating forever
+    tsc_saving_buffer bad = tsc_saving_newBuffer(NULL);
+    tsc_saving_writeBytes(&bad, buffer.mem, chunkc - buffer.mem);
+    tsc_saving_writeStr(&bad, "zzzz");
+    tsc_saving_writeStr(&bad, index - 1);
+    tsc_saving_decodeWith(bad.mem, out, "TSC2");
+    tsc_saving_deleteBuffer(bad);
+    tsc_assert(out->width == width && out->height == height, "TSC2 with a bad chunk count is %dx%d, not %dx%d", out->width, out->height, width, height);
+    if(out->width == width && out->height == height) {
+        tsc_testSaving_compare("TSC2 with a bad chunk count", grid, out, 0, area);
+    }
+
     tsc_saving_deleteBuffer(buffer);
+    tsc_deleteGrid(out);
+    tsc_deleteGrid(grid);
+}
+
+static void tsc_testSaving_longVanilla() {
+    tsc_test("Decoding long TSC vanilla runs");
+    // The encoder never makes runs this long, so the record is made by hand.
+    // It has to be over TSC_TSC_WINDOW * 2 cells to not fit in the window, and odd so the last piece has half a byte.
+    int width = 521;
+    int height = TSC_TSC_WINDOW * 2 / width + 2;
+    size_t area = (size_t)width * height;
+
+    size_t recordLen = 5 + area / 2 + (area & 1);
+    unsigned char *record = malloc(recordLen);
+    record[0] = 'K';
+    for(int i = 0; i < 4; i++) record[1 + i] = (area >> (i * 8)) & 0xFF;
+    memset(record + 5, 0, recordLen - 5);
+    for(size_t i = 0; i < area; i++) {
+        record[5 + i / 2] |= ((i * 7 + i / 3) % 16) << ((i % 2) * 4);
+    }
+
+    size_t compressedLen;
+    unsigned char *compressed = tsc_engine_compress(record, recordLen, &compressedLen);
+    size_t base64Len;
+    char *base64 = tsc_engine_encodeBase64(compressed, compressedLen, &base64Len);
+    tsc_engine_free(compressed);
+    free(record);
+
+    // The width and height come from encoding an empty grid of that size, only the cells are made up
+    tsc_grid *empty = tsc_createGrid("test", width, height, NULL, NULL);
+    tsc_saving_buffer buffer = tsc_saving_newBuffer(NULL);
+    tsc_saving_encodeWith(&buffer, empty, "TSC");
+    tsc_deleteGrid(empty);
+    const char *cells = buffer.mem + 4;
+    for(int i = 0; i < 2; i++) cells = strchr(cells, ';') + 1;
 
-    tsc_assert(grid->width == out->width, "width went from %d to %d", grid->width, out->width);
-    tsc_assert(grid->height == out->height, "height went from %d to %d", grid->height, out->height);
+    tsc_saving_buffer code = tsc_saving_newBuffer(NULL);
+    tsc_saving_writeBytes(&code, buffer.mem, cells - buffer.mem);
+    tsc_saving_writeBytes(&code, base64, base64Len);
+    tsc_saving_write(&code, ';');
+    tsc_saving_deleteBuffer(buffer);
+    tsc_engine_free(base64);
 
-    for(int x = 0; x < grid->width; x++) {
-        for(int y = 0; y < grid->height; y++) {
-            tsc_cell *a = tsc_grid_get(grid, x, y);
-            tsc_cell *b = tsc_grid_get(out, x, y);
+    tsc_grid *out = tsc_createGrid("out", 1, 1, NULL, NULL);
+    tsc_saving_decodeWith(code.mem, out, "TSC");
+    tsc_saving_deleteBuffer(code);
 
-            // They should be the exact same pointer
-            tsc_assert(a->id == b->id, "at %d,%d cell ID %s became %s", x, y, a->id, b->id);
-            tsc_assert(a->rot == b->rot, "at %d,%d cell rot %d became %d", x, y, a->rot, b->rot);
+    tsc_assert(out->width == width && out->height == height, "long vanilla run grid is %dx%d, not %dx%d", out->width, out->height, width, height);
+    if(out->width == width && out->height == height) {
+        for(size_t i = 0; i < area; i++) {
+            tsc_id_t id;
+            char rot;
+            tsc_testSaving_vanilla((i * 7 + i / 3) % 16, &id, &rot);
+            tsc_cell *cell = tsc_grid_get(out, i % width, i / width);
+            if(cell->id != id || tsc_cell_getRotation(cell) != rot) {
+                tsc_fail("long vanilla run: cell %zu should be %d (rot %d), got %d (rot %d)", i, id, rot, cell->id, tsc_cell_getRotation(cell));
+                break;
+            }
         }
     }
+    tsc_deleteGrid(out);
+}
 
-    tsc_deleteGrid(grid);
+void tsc_testSaving() {
+    tsc_testSaving_v3();
+    tsc_testSaving_tsc();
+    tsc_testSaving_longVanilla();
 }
@@ -8,14 +8,16 @@
 #include "cells/subticks.h"
 #include "saving/saving.h"
 #include "threads/workers.h"
-#include <raylib.h>
 #include "api/api.h"
 
 void tsc_test(const char *name) {
     printf("[ TESTING ] %s\n", name);
 }
 
+static int tsc_failures = 0;
+
 void tsc_vafail(const char *fmt, va_list args) {
+    tsc_failures++;
     static char buffer[1024];
     vsnprintf(buffer, 1024, fmt, args);
     fprintf(stderr, "[ FAILED ] %s\n", buffer);
@@ -52,4 +54,11 @@ int main(void) {
     tsc_loadDefaultCellBar();
 
     tsc_testSaving();
+
+    if(tsc_failures > 0) {
+        fprintf(stderr, "%d tests failed\n", tsc_failures);
+        return 1;
+    }
+    printf("All tests passed\n");
+    return 0;
 }
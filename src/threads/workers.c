@@ -65,79 +65,225 @@ static void workers_addToWaitGroup(volatile worker_waitgroup_t *wg, size_t amoun
     atomic_fetch_add_explicit(&wg->count, amount, memory_order_relaxed);
 }
 
-static void workers_removeFromWaitGroup(volatile worker_waitgroup_t *wg) {
-    atomic_fetch_sub_explicit(&wg->count, 1, memory_order_relaxed);
+// Threads blocked until a waitgroup is done
+static mtx_t workers_doneLock;
+static cnd_t workers_groupDone;
+static atomic_long workers_waiting;
+
+static void workers_removeFromWaitGroup(volatile worker_waitgroup_t *wg, size_t amount) {
+    if(atomic_fetch_sub(&wg->count, amount) != amount) return;
+    // The waiter may have already seen 0 and returned, so wg can't be touched anymore
+    if(atomic_load(&workers_waiting) == 0) return;
+    mtx_lock(&workers_doneLock);
+    cnd_broadcast(&workers_groupDone);
+    mtx_unlock(&workers_doneLock);
 }
 
-static void workers_waitForGroup(volatile worker_waitgroup_t *wg) {
-    while(true) {
-        size_t amount = atomic_load_explicit(&wg->count, memory_order_relaxed);
-        if(amount == 0) break;
-        thrd_yield();
-    }
+static bool workers_isGroupDone(volatile worker_waitgroup_t *wg) {
+    return atomic_load(&wg->count) == 0;
 }
 
-typedef struct worker_task_info_t {
+// A job is one call to workers_waitForTasks(Flat) or workers_addTask.
+// Instead of 1 queued task per element, it's a range of elements which gets split in half by whoever
+// runs it until the pieces are small enough, and the halves that are not being ran can be stolen.
+typedef struct worker_job_t {
     worker_task_t *task;
     void *data;
+    size_t dataSize; // 0 means data is an array of pointers
+    size_t grain;
     volatile worker_waitgroup_t *wg;
-} worker_task_info_t;
-
-typedef struct worker_channel_t {
-    mtx_t lock;
-    cnd_t taskCompleted;
-    cnd_t taskGiven;
-    volatile size_t len;
-    volatile size_t cap;
-    worker_task_info_t *volatile info;
-} worker_channel_t;
-
-static worker_channel_t workers_channel;
+    struct worker_range_t *ranges;
+    atomic_size_t rangec;
+    size_t rangecap;
+    bool owned; // freed by whoever finishes it, for workers_addTask
+    void *single; // the data array of workers_addTask
+} worker_job_t;
+
+typedef struct worker_range_t {
+    worker_job_t *job;
+    size_t begin;
+    size_t end;
+} worker_range_t;
+
+// Chase-Lev deque. The owner pushes and pops at the bottom, everyone else steals from the top.
+// It doesn't grow, ranges only get split log2(len) times so it never gets close to full,
+// and if it somehow does the range just runs without being split further.
+#define WORKERS_DEQUE_SIZE 256
+// How many times a thread with nothing to do yields before it goes to sleep
+#define WORKERS_SPIN 64
+// Deques for threads which aren't workers (the main thread, the renderer, saving...), borrowed while they wait for tasks.
+// If they're all taken, the thread just does its own tasks.
+#define WORKERS_EXTERNAL 8
+
+typedef struct worker_deque_t {
+    atomic_long top;
+    atomic_long bottom;
+    _Atomic(worker_range_t *) buffer[WORKERS_DEQUE_SIZE];
+} worker_deque_t;
+
 static size_t workers_count;
 static thrd_t *workers_threads;
+// 1 per worker that could exist, then WORKERS_EXTERNAL for threads which aren't workers
+static worker_deque_t *workers_deques;
+static size_t workers_dequec;
+static size_t workers_max;
+static atomic_bool workers_externalUsed[WORKERS_EXTERNAL];
+static mtx_t workers_sleepLock;
+static cnd_t workers_wakeUp;
+static atomic_long workers_pending;
+static atomic_long workers_sleeping;
+static _Thread_local worker_deque_t *workers_own = NULL;
+
+static bool workers_deque_push(worker_deque_t *deque, worker_range_t *range) {
+    long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if(b - t >= WORKERS_DEQUE_SIZE) return false;
+    atomic_store_explicit(deque->buffer + (b % WORKERS_DEQUE_SIZE), range, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
 
-static void workers_channel_addUnsafe(worker_task_t *task, void *data, volatile worker_waitgroup_t *wg) {
-    worker_task_info_t info = {task, data, wg};
-    size_t idx = workers_channel.len;
-    workers_channel.len++;
-    if(workers_channel.len == workers_channel.cap) {
-        workers_channel.cap *= 2;
-        workers_channel.info = realloc(workers_channel.info, sizeof(worker_task_info_t) * workers_channel.cap);
+static worker_range_t *workers_deque_pop(worker_deque_t *deque) {
+    long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if(t > b) {
+        // Empty
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+    worker_range_t *range = atomic_load_explicit(deque->buffer + (b % WORKERS_DEQUE_SIZE), memory_order_relaxed);
+    if(t == b) {
+        // Last one, race the thieves for it
+        if(!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+            range = NULL;
+        }
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
     }
-    workers_channel.info[idx] = info;
+    return range;
 }
 
-static void workers_channel_add(worker_task_t *task, void *data, volatile worker_waitgroup_t *wg) {
-    mtx_lock(&workers_channel.lock);
-    workers_channel_addUnsafe(task, data, wg);
-    mtx_unlock(&workers_channel.lock);
+// Sets *contended if it lost a race, in which case there may still be something to steal
+static worker_range_t *workers_deque_steal(worker_deque_t *deque, bool *contended) {
+    long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if(t >= b) return NULL;
+    worker_range_t *range = atomic_load_explicit(deque->buffer + (t % WORKERS_DEQUE_SIZE), memory_order_relaxed);
+    if(!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        *contended = true;
+        return NULL;
+    }
+    return range;
+}
+
+static void workers_notify() {
+    if(atomic_load(&workers_sleeping) == 0) return;
+    mtx_lock(&workers_sleepLock);
+    cnd_broadcast(&workers_wakeUp);
+    mtx_unlock(&workers_sleepLock);
 }
 
-static worker_task_info_t workers_getTask() {
-    worker_task_info_t notask = {NULL, NULL, NULL};
-    if(workers_channel.len == 0) return notask;
-    return workers_channel.info[--workers_channel.len];
+static bool workers_give(worker_deque_t *deque, worker_range_t *range) {
+    atomic_fetch_add(&workers_pending, 1);
+    if(!workers_deque_push(deque, range)) {
+        atomic_fetch_sub(&workers_pending, 1);
+        return false;
+    }
+    workers_notify();
+    return true;
+}
+
+static worker_range_t *workers_take(worker_deque_t *deque, bool *contended) {
+    worker_range_t *range = workers_deque_pop(deque);
+    if(range != NULL) {
+        atomic_fetch_sub(&workers_pending, 1);
+        return range;
+    }
+    size_t self = deque - workers_deques;
+    for(size_t i = 1; i < workers_dequec; i++) {
+        worker_deque_t *victim = workers_deques + (self + i) % workers_dequec;
+        range = workers_deque_steal(victim, contended);
+        if(range != NULL) {
+            atomic_fetch_sub(&workers_pending, 1);
+            return range;
+        }
+    }
+    return NULL;
+}
+
+static worker_range_t *workers_newRange(worker_job_t *job, size_t begin, size_t end) {
+    size_t i = atomic_fetch_add_explicit(&job->rangec, 1, memory_order_relaxed);
+    if(i >= job->rangecap) return NULL;
+    worker_range_t *range = job->ranges + i;
+    range->job = job;
+    range->begin = begin;
+    range->end = end;
+    return range;
+}
+
+static void workers_run(worker_deque_t *deque, worker_range_t *range) {
+    worker_job_t *job = range->job;
+    size_t begin = range->begin;
+    size_t end = range->end;
+
+    // Keep the first half, give away the second
+    while(end - begin > job->grain) {
+        size_t mid = begin + (end - begin) / 2;
+        worker_range_t *half = workers_newRange(job, mid, end);
+        if(half == NULL) break;
+        if(!workers_give(deque, half)) break;
+        end = mid;
+    }
+
+    if(job->dataSize == 0) {
+        void **dataArr = job->data;
+        for(size_t i = begin; i < end; i++) job->task(dataArr[i]);
+    } else {
+        char *dataArr = job->data;
+        for(size_t i = begin; i < end; i++) job->task(dataArr + i * job->dataSize);
+    }
+
+    if(job->wg != NULL) {
+        workers_removeFromWaitGroup(job->wg, end - begin);
+    } else if(job->owned) {
+        free(job->ranges);
+        free(job);
+    }
 }
 
 static int workers_worker(void *pid) {
     size_t id = (size_t)pid;
-    mtx_lock(&workers_channel.lock);
+    worker_deque_t *deque = workers_deques + id;
+    workers_own = deque;
+    size_t idle = 0;
     while(1) {
-        if(id >= workers_count) {
-            mtx_unlock(&workers_channel.lock);
-            thrd_exit(0);
+        bool contended = false;
+        worker_range_t *range = workers_take(deque, &contended);
+        if(range != NULL) {
+            workers_run(deque, range);
+            idle = 0;
+            continue;
         }
-        worker_task_info_t task = workers_getTask();
-        if(task.task == NULL) {
-            cnd_wait(&workers_channel.taskGiven, &workers_channel.lock);
-        } else {
-            mtx_unlock(&workers_channel.lock);
-            task.task(task.data);
-            if(task.wg != NULL) workers_removeFromWaitGroup(task.wg);
-            // Say task completed
-            cnd_broadcast(&workers_channel.taskCompleted);
-            mtx_lock(&workers_channel.lock);
+        // Our own deque is empty at this point, so leaving is safe
+        if(id >= workers_count) break;
+        // Subticks come in quick succession, so give the next one a moment before sleeping
+        if(contended || idle < WORKERS_SPIN) {
+            idle++;
+            thrd_yield();
+            continue;
         }
+        idle = 0;
+
+        mtx_lock(&workers_sleepLock);
+        atomic_fetch_add(&workers_sleeping, 1);
+        if(atomic_load(&workers_pending) == 0 && id < workers_count) {
+            cnd_wait(&workers_wakeUp, &workers_sleepLock);
+        }
+        atomic_fetch_sub(&workers_sleeping, 1);
+        mtx_unlock(&workers_sleepLock);
     }
     return 0;
 }
@@ -151,17 +297,26 @@ void workers_setAmount(int newCount) {
     if(newCount > amount) {
         newCount = amount;
     }
+    if(newCount > workers_max) {
+        newCount = workers_max;
+    }
     size_t old = workers_count;
     workers_count = newCount;
-    if(workers_count == 0) {
-        // Nothing left
-        free(workers_threads);
-        workers_threads = NULL;
-        cnd_broadcast(&workers_channel.taskGiven);
-    } else if(workers_count < old) {
-        // Shrink
-        workers_threads = realloc(workers_threads, sizeof(thrd_t) * workers_count);
-        cnd_broadcast(&workers_channel.taskGiven);
+    if(workers_count < old) {
+        // Shrink. We wait for them to leave so their deques are free to use again.
+        mtx_lock(&workers_sleepLock);
+        cnd_broadcast(&workers_wakeUp);
+        mtx_unlock(&workers_sleepLock);
+        for(size_t i = workers_count; i < old; i++) {
+            thrd_join(workers_threads[i], NULL);
+        }
+        if(workers_count == 0) {
+            // Nothing left
+            free(workers_threads);
+            workers_threads = NULL;
+        } else {
+            workers_threads = realloc(workers_threads, sizeof(thrd_t) * workers_count);
+        }
     } else if(workers_count > old) {
         // Grow
         workers_threads = realloc(workers_threads, sizeof(thrd_t) * workers_count);
@@ -176,12 +331,28 @@ bool workers_isDisabled() {
 }
 
 void workers_setup(int count) {
-    mtx_init(&workers_channel.lock, mtx_recursive);
-    cnd_init(&workers_channel.taskCompleted);
-    cnd_init(&workers_channel.taskGiven);
-    workers_channel.len = 0;
-    workers_channel.cap = 20;
-    workers_channel.info = malloc(sizeof(worker_task_info_t) * workers_channel.cap);
+    mtx_init(&workers_sleepLock, mtx_plain);
+    cnd_init(&workers_wakeUp);
+    mtx_init(&workers_doneLock, mtx_plain);
+    cnd_init(&workers_groupDone);
+    atomic_init(&workers_waiting, 0);
+    atomic_init(&workers_pending, 0);
+    atomic_init(&workers_sleeping, 0);
+    size_t max = workers_idealAmount();
+    if(count > max) max = count;
+    workers_max = max;
+    workers_dequec = max + WORKERS_EXTERNAL;
+    for(size_t i = 0; i < WORKERS_EXTERNAL; i++) {
+        atomic_init(workers_externalUsed + i, false);
+    }
+    workers_deques = malloc(sizeof(worker_deque_t) * workers_dequec);
+    for(size_t i = 0; i < workers_dequec; i++) {
+        atomic_init(&workers_deques[i].top, 0);
+        atomic_init(&workers_deques[i].bottom, 0);
+        for(size_t j = 0; j < WORKERS_DEQUE_SIZE; j++) {
+            atomic_init(workers_deques[i].buffer + j, NULL);
+        }
+    }
     workers_count = count;
     workers_threads = malloc(sizeof(thrd_t) * count);
     for(int i = 0; i < count; i++) {
@@ -204,9 +375,113 @@ void workers_setupBest() {
     workers_setup(workers_idealAmount());
 }
 
+static void workers_initJob(worker_job_t *job, worker_task_t *task, void *data, size_t dataSize, size_t len, volatile worker_waitgroup_t *wg) {
+    job->task = task;
+    job->data = data;
+    job->dataSize = dataSize;
+    // A few pieces per worker, so stealing can even things out if some rows are busier than others
+    job->grain = len / (workers_count * 4 + 1);
+    if(job->grain == 0) job->grain = 1;
+    job->wg = wg;
+    // Every split makes 1 range and pieces are never smaller than half the grain
+    job->rangecap = 2 * len / job->grain + 2;
+    job->ranges = malloc(sizeof(worker_range_t) * job->rangecap);
+    atomic_init(&job->rangec, 0);
+    job->owned = false;
+}
+
+// Threads which aren't workers borrow a free external deque. NULL if they already have one (or are a worker),
+// and also if there's none left, in which case workers_own stays NULL.
+static worker_deque_t *workers_enter() {
+    if(workers_own != NULL) return NULL;
+    for(size_t i = 0; i < WORKERS_EXTERNAL; i++) {
+        if(atomic_load_explicit(workers_externalUsed + i, memory_order_relaxed)) continue;
+        if(atomic_exchange_explicit(workers_externalUsed + i, true, memory_order_acquire)) continue;
+        workers_own = workers_deques + workers_max + i;
+        return workers_own;
+    }
+    return NULL;
+}
+
+static void workers_leave(worker_deque_t *entered) {
+    if(entered == NULL) return;
+    workers_own = NULL;
+    atomic_store_explicit(workers_externalUsed + (entered - workers_deques - workers_max), false, memory_order_release);
+}
+
+// For when there's no deque to put them in
+static void workers_runHere(worker_task_t *task, void *data, size_t dataSize, size_t len) {
+    if(dataSize == 0) {
+        void **dataArr = data;
+        for(size_t i = 0; i < len; i++) task(dataArr[i]);
+    } else {
+        char *dataArr = data;
+        for(size_t i = 0; i < len; i++) task(dataArr + i * dataSize);
+    }
+}
+
+static void workers_waitForGroup(worker_deque_t *deque, volatile worker_waitgroup_t *wg) {
+    size_t idle = 0;
+    while(!workers_isGroupDone(wg)) {
+        bool contended = false;
+        worker_range_t *range = workers_take(deque, &contended);
+        if(range != NULL) {
+            workers_run(deque, range);
+            idle = 0;
+            continue;
+        }
+        if(contended || idle < WORKERS_SPIN) {
+            idle++;
+            thrd_yield();
+            continue;
+        }
+        // Whatever is left is already being ran by someone, so sleep until they're done
+        mtx_lock(&workers_doneLock);
+        atomic_fetch_add(&workers_waiting, 1);
+        while(!workers_isGroupDone(wg)) {
+            cnd_wait(&workers_groupDone, &workers_doneLock);
+        }
+        atomic_fetch_sub(&workers_waiting, 1);
+        mtx_unlock(&workers_doneLock);
+    }
+}
+
+static void workers_submit(worker_task_t *task, void *data, size_t dataSize, size_t len) {
+    worker_deque_t *entered = workers_enter();
+    worker_deque_t *deque = workers_own;
+    if(deque == NULL) {
+        workers_runHere(task, data, dataSize, len);
+        return;
+    }
+
+    worker_waitgroup_t wg = workers_createWaitGroup();
+    workers_addToWaitGroup(&wg, len);
+    worker_job_t job;
+    workers_initJob(&job, task, data, dataSize, len, &wg);
+
+    worker_range_t *root = workers_newRange(&job, 0, len);
+    // We help out instead of just waiting, which also means nothing gets stuck if the workers are leaving
+    workers_run(deque, root);
+    workers_waitForGroup(deque, &wg);
+    workers_leave(entered);
+    free(job.ranges);
+}
+
 void workers_addTask(worker_task_t *task, void *data) {
-    workers_channel_add(task, data, NULL);
-    cnd_signal(&workers_channel.taskGiven);
+    worker_deque_t *entered = workers_enter();
+    if(workers_own == NULL) {
+        task(data);
+        return;
+    }
+    worker_job_t *job = malloc(sizeof(worker_job_t));
+    // The job holds the data pointer itself, since nobody waits for it
+    job->single = data;
+    workers_initJob(job, task, &job->single, 0, 1, NULL);
+    job->owned = true;
+    if(!workers_give(workers_own, workers_newRange(job, 0, 1))) {
+        workers_run(workers_own, job->ranges);
+    }
+    workers_leave(entered);
 }
 
 void workers_waitForTasks(worker_task_t *task, void **dataArr, size_t len) {
@@ -214,15 +489,8 @@ void workers_waitForTasks(worker_task_t *task, void **dataArr, size_t len) {
         for(int i = 0; i < len; i++) task(dataArr[i]);
         return;
     }
-    worker_waitgroup_t wg = workers_createWaitGroup();
-    workers_addToWaitGroup(&wg, len);
-    mtx_lock(&workers_channel.lock);
-    for(int i = 0; i < len; i++) {
-        workers_channel_addUnsafe(task, dataArr[i], &wg);
-    }
-    mtx_unlock(&workers_channel.lock);
-    cnd_broadcast(&workers_channel.taskGiven);
-    workers_waitForGroup(&wg);
+    if(len == 0) return;
+    workers_submit(task, dataArr, 0, len);
 }
 
 void workers_waitForTasksFlat(worker_task_t *task, void *dataArr, size_t dataSize, size_t len) {
@@ -233,16 +501,8 @@ void workers_waitForTasksFlat(worker_task_t *task, void *dataArr, size_t dataSiz
         }
         return;
     }
-    worker_waitgroup_t wg = workers_createWaitGroup();
-    workers_addToWaitGroup(&wg, len);
-    mtx_lock(&workers_channel.lock);
-    for(int i = 0; i < len; i++) {
-        workers_channel_addUnsafe(task, dataArr, &wg);
-        dataArr += dataSize;
-    }
-    mtx_unlock(&workers_channel.lock);
-    cnd_broadcast(&workers_channel.taskGiven);
-    workers_waitForGroup(&wg);
+    if(len == 0) return;
+    workers_submit(task, dataArr, dataSize, len);
 }
 
 int workers_amount() {